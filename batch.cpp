@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <SDL2/SDL.h>
+
+#include "batch.hpp"
+#include "board.hpp"
+#include "engine.hpp"
+#include "record.hpp"
+
+struct BatchState {
+		std::mutex lock;
+		std::condition_variable ready, space;
+		std::deque<std::pair<unsigned long, std::string>> queue;
+		std::map<unsigned long, std::string> results;
+		unsigned long written, failed;
+		bool done;
+		std::FILE* out;
+};
+
+// Writes all results that are next in line; the caller holds the lock.
+static void FlushResults(BatchState& state) {
+	auto it = state.results.begin();
+	while (it != state.results.end() and it->first == state.written) {
+		std::fputs(it->second.c_str(), state.out);
+		it = state.results.erase(it);
+		state.written++;
+	}
+
+	std::fflush(state.out);
+	state.space.notify_one();
+}
+
+static void BatchWorker(BatchState& state, int depth) {
+	Engine engine;
+	engine.useBook = false;
+
+	while (true) {
+		std::pair<unsigned long, std::string> job;
+		{
+			std::unique_lock<std::mutex> guard(state.lock);
+			state.ready.wait(guard, [&state] {
+				return state.done or !state.queue.empty();
+			});
+
+			if (state.queue.empty()) return;
+
+			job = state.queue.front();
+			state.queue.pop_front();
+			state.space.notify_one();
+		}
+
+		std::string line;
+		Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+		bool readable = board.LoadPosition(job.second);
+
+		if (!readable) {
+			line = job.second + "\terror\n";
+		} else {
+			unsigned start = SDL_GetTicks();
+			SearchResult r = engine.Search(&board, depth);
+
+			char buf[128];
+			std::snprintf(buf, sizeof(buf), "\t%.3f\t%d\t%lu\t%u\n", r.score, r.depth, r.nodes, SDL_GetTicks() - start);
+			line = job.second + '\t' + (r.found ? TurnString(r.turn) : "none") + buf;
+		}
+
+		std::lock_guard<std::mutex> guard(state.lock);
+		if (!readable) state.failed++;
+		state.results[job.first] = line;
+		FlushResults(state);
+	}
+}
+
+bool AnalyseBatch(std::string input, std::string output, int depth, int threads) {
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::FILE* in = (input == "-" ? stdin : std::fopen(input.c_str(), "r"));
+	if (in == nullptr) {
+		printf("Failed to open %s.\n", input.c_str());
+		return false;
+	}
+
+	BatchState state;
+	state.written = 0;
+	state.failed = 0;
+	state.done = false;
+	state.out = (output == "-" ? stdout : std::fopen(output.c_str(), "w"));
+	if (state.out == nullptr) {
+		printf("Failed to open %s for writing.\n", output.c_str());
+		if (in != stdin) std::fclose(in);
+		return false;
+	}
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.push_back(std::thread(BatchWorker, std::ref(state), depth));
+	}
+
+	// Keep only a few positions per thread in memory, so arbitrarily long inputs can be streamed,
+	// and stop reading when a slow position holds back too many finished results.
+	const std::size_t limit = 4 * threads;
+	unsigned long count = 0;
+	char buf[1024];
+
+	while (std::fgets(buf, sizeof(buf), in) != nullptr) {
+		std::string l(buf);
+		while (!l.empty() and (l.back() == '\n' or l.back() == '\r')) {
+			l.pop_back();
+		}
+
+		if (l.empty()) continue;
+
+		std::unique_lock<std::mutex> guard(state.lock);
+		state.space.wait(guard, [&state, limit, count] {
+			return state.queue.size() < limit and count - state.written < 16 * limit;
+		});
+
+		state.queue.push_back(std::make_pair(count++, l));
+		state.ready.notify_one();
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.done = true;
+	}
+	state.ready.notify_all();
+
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	if (in != stdin) std::fclose(in);
+	if (state.out != stdout) std::fclose(state.out);
+
+	// The lines are in the output, the exit status tells scripts that there were any.
+	if (state.failed > 0 and state.out != stdout) printf("%lu of %lu positions could not be read.\n", state.failed, count);
+	return state.failed == 0;
+}
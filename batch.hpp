@@ -0,0 +1,11 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <string>
+
+// Reads positions in summary() notation, one per line, from input ("-" for stdin) and writes the
+// best turn, score, depth, nodes and time for each of them to output ("-" for stdout), in input
+// order, searching up to `threads` positions at once with one engine per thread.
+bool AnalyseBatch(std::string input, std::string output, int depth, int threads);
+
+#endif // BATCH_HPP
@@ -1,8 +1,8 @@
 #include <algorithm>
 #include <cmath>
 #include <cstring>
-#include <random>
 #include <sstream>
+#include <unordered_map>
 #include <utility>
 
 #include <SDL2/SDL.h>
@@ -10,634 +10,442 @@
 
 #include "board.hpp"
 #include "defines.hpp"
+#include "engine.hpp"
 #include "piece.hpp"
+#include "rules.hpp"
 #include "utils.hpp"
 
-static std::random_device rd;
-static std::mt19937 gen(rd());
-
 Board::Board(int width, int height) {
 	this->width = width;
 	this->height = height;
+	this->rules = RulesFor(width, height);
 	this->selection = nullptr;
-	this->turn = true;
-	this->passstate = 0;
-
 	this->reinstate = 0;
 
-	this->p1_pawns = 0;
-	this->p1_knights = 0;
-	this->p2_pawns = 0;
-	this->p2_knights = 0;
+	this->position = { };
+	this->position.width = width;
+	this->position.height = height;
+	this->position.turn = 1;
 
-	this->p1_pawns_c = 0;
-	this->p1_knights_c = 0;
-	this->p2_pawns_c = 0;
-	this->p2_knights_c = 0;
+	this->overlay_moves = { };
+	this->overlay_captures = { };
+	this->overlay_selection = nullptr;
+	this->overlay_stale = true;
+	this->background = nullptr;
 
 	this->piece_moves = new Piece*[3];
 	this->moves = new Move[3];
 	this->position_history = "";
+	this->start_position = "";
 
 	for (int i = 0; i < 3; i++) {
 		piece_moves[i] = nullptr;
 	}
 }
 
-Board::Board(Board* b, Turn t) {
+Board::Board(const WidePosition& position) : Board(position.width, position.height) {
+	this->position = position;
+	this->start_position = this->summary();
+	Sync();
+}
+
+Board::Board(Board* b) {
 	this->width = b->width;
 	this->height = b->height;
+	this->rules = b->rules;
+	this->position = b->position;
 	this->selection = nullptr;
-	this->turn = b->turn;
-	this->passstate = b->passstate;
-
-	this->reinstate = t.flags & (TURN_REINFORCE | TURN_REINFORCE_KNIGHT);
-
-	this->p1_pawns = b->p1_pawns;
-	this->p1_knights = b->p1_knights;
-	this->p2_pawns = b->p2_pawns;
-	this->p2_knights = b->p2_knights;
+	this->reinstate = 0;
 
-	this->p1_pawns_c = b->p1_pawns_c;
-	this->p1_knights_c = b->p1_knights_c;
-	this->p2_pawns_c = b->p2_pawns_c;
-	this->p2_knights_c = b->p2_knights_c;
+	this->overlay_moves = { };
+	this->overlay_captures = { };
+	this->overlay_selection = nullptr;
+	this->overlay_stale = true;
+	this->background = nullptr;
 
 	this->piece_moves = new Piece*[3];
-	this->moves = t.moves;
+	this->moves = new Move[3];
 	this->position_history = std::string(b->position_history);
+	this->hash_history = b->hash_history;
+	this->start_position = b->start_position;
+	this->turn_history = b->turn_history;
 
-	for (Piece* p : b->pieces) {
-		Piece* q = new Piece(*p);
-		pieces.push_back(q);
-	}
-
-#ifdef RANDOMIZE_UNITS
-	pieces.shrink_to_fit();
-	std::shuffle(pieces.begin(), pieces.end(), gen);
-#endif // RANDOMIZE_UNITS
+	// Copies must point at this board, otherwise their legality checks look at the parent position.
+	Sync();
 
 	for (int i = 0; i < 3; i++) {
 		piece_moves[i] = nullptr;
-		if (moves[i].x1 != moves[i].x2 and moves[i].y1 != moves[i].y2) {
-			piece_moves[i] = this->pieceAt(moves[i].x1, moves[i].y1);
-		}
 	}
+}
 
-	ChangeTurn();
+Board::Board(Board* b, Turn t) : Board(b) {
+	PlayTurn(t);
 }
 
 Board::~Board() {
 	Clear();
+	ResetTextures();
+
+	delete[] piece_moves;
+	delete[] moves;
 }
 
 void Board::NewGame(int pawns, int knights, int flanking) {
 	Clear();
 
 	for (int x = flanking; x < width - flanking; x++) {
-		Piece* p = new Piece(this, false, false, x, 0);
-		Piece* q = new Piece(this, true, false, x, height - 1);
-
-		pieces.push_back(p);
-		pieces.push_back(q);
+		AddPiece(false, false, x, 0);
+		AddPiece(true, false, x, height - 1);
 	}
 
 	for (int x = 0; x < flanking; x++) {
-		Piece* k = new Piece(this, false, true, x, 0);
-		Piece* l = new Piece(this, false, true, width - x - 1, 0);
+		AddPiece(false, true, x, 0);
+		AddPiece(false, true, width - x - 1, 0);
 
-		Piece* m = new Piece(this, true, true, x, height - 1);
-		Piece* n = new Piece(this, true, true, width - x - 1, height - 1);
-
-		pieces.push_back(k);
-		pieces.push_back(l);
-		pieces.push_back(m);
-		pieces.push_back(n);
+		AddPiece(true, true, x, height - 1);
+		AddPiece(true, true, width - x - 1, height - 1);
 	}
 
-	pieces.shrink_to_fit();
-	std::shuffle(pieces.begin(), pieces.end(), gen);
-
 	int ps = pawns - width + 2 * flanking;
 	int ks = knights - 2 * flanking;
 
-	this->p1_pawns = (ps < 0 ? 0 : ps);
-	this->p1_knights = (ks < 0 ? 0 : ks);
-	this->p2_pawns = (ps < 0 ? 0 : ps);
-	this->p2_knights = (ks < 0 ? 0 : ks);
+	SetReserves(MAX(ps, 0), MAX(ks, 0), MAX(ps, 0), MAX(ks, 0));
 
-	this->p1_pawns_c = 0;
-	this->p1_knights_c = 0;
-	this->p2_pawns_c = 0;
-	this->p2_knights_c = 0;
+	for (int i = 0; i < 2; i++) {
+		this->position.captures[i][0] = 0;
+		this->position.captures[i][1] = 0;
+	}
 
-	this->passstate = 2; // Do not permit first-turn passing.
+	this->position.pass = 2; // Do not permit first-turn passing.
 	this->position_history = "";
+	this->hash_history.clear();
+	this->start_position = "";
+	this->turn_history.clear();
 }
 
-void Board::LoadGame(std::string filename) {
-	std::FILE* pFile = std::fopen(filename.c_str(), "r");
+bool Board::LoadPosition(std::string summary) {
+	std::size_t close = summary.find(']');
+	if (summary.empty() or summary[0] != '[' or close == std::string::npos) return false;
 
-	std::fclose(pFile);
-}
+	struct Placement {
+			bool side, knight;
+			int x, y;
+	};
 
-void Board::SaveGame(std::string filename) {
-	std::FILE* pFile = std::fopen(filename.c_str(), "w");
-	std::fprintf(pFile, position_history.c_str());
-	std::fclose(pFile);
-}
+	std::vector<Placement> placed;
+	int x = 0, y = 0, w = -1;
 
-void Board::Clear() {
-	while (!pieces.empty()) {
-		Piece* p = pieces.back();
-		pieces.pop_back();
-		delete p;
-	}
-}
+	for (std::size_t i = 1; i < close; i++) {
+		char c = summary[i];
 
-bool Board::isEmpty(int x, int y) {
-	for (Piece* p : this->pieces) {
-		if (p->getX() == x and p->getY() == y) {
+		if (c >= '0' and c <= '9') {
+			int n = 0;
+			while (i < close and summary[i] >= '0' and summary[i] <= '9') {
+				n = 10 * n + (summary[i++] - '0');
+				if (n > BOARD_MAX_SIZE) return false;
+			}
+			i--;
+			x += n;
+		} else if (c == '/') {
+			if (w < 0) w = x;
+			else if (x != w) return false;
+			x = 0;
+			y++;
+		} else if (c == 'P' or c == 'K' or c == 'p' or c == 'k') {
+			placed.push_back( { c == 'P' or c == 'K', c == 'K' or c == 'k', x, y });
+			x++;
+		} else {
 			return false;
 		}
 	}
 
-	return true;
-}
+	if (w < 0) w = x;
+	if (x != w or w <= 0) return false;
+	if (RulesFor(w, y + 1) == nullptr) return false;
 
-Piece* Board::pieceAt(int x, int y) {
-	for (Piece* p : this->pieces) {
-		if (p->getX() == x and p->getY() == y) {
-			return p;
-		}
-	}
-
-	return nullptr;
-}
-
-void Board::ChangeTurn() {
-	bool didmove = false;
-	if (reinstate > 0) {
-		Piece* p = new Piece(this, turn, (reinstate == 2), moves[0].x2, moves[0].y2);
-		pieces.push_back(p);
-
-		if (turn) {
-			if (reinstate == 2) p1_knights--;
-			else p1_pawns--;
-		} else {
-			if (reinstate == 2) p2_knights--;
-			else p2_pawns--;
-		}
-
-		didmove = true;
-	} else {
-		for (int i = 0; i < 3; i++) {
-			Piece* p = piece_moves[i];
-
-			if (p == nullptr) {
-				continue;
-			}
-
-			Move m = moves[i];
-
-			Piece* q = pieceAt(m.x2, m.y2);
-			if (q != nullptr) {
-				if (turn) {
-					if (p->isKnight()) p1_knights++;
-					else p1_pawns++;
-
-					if (q->isKnight()) p1_knights_c++;
-					else p1_pawns_c++;
-				} else {
-					if (p->isKnight()) p2_knights++;
-					else p2_pawns++;
-
-					if (q->isKnight()) p2_knights_c++;
-					else p2_pawns_c++;
-				}
+	int pass, p1p, p1k, p2p, p2k, side;
+	std::istringstream ss(summary.substr(close + 1));
+	if (!(ss >> pass >> p1p >> p1k >> p2p >> p2k >> side)) return false;
+	if (pass < 0 or pass > 2 or side < 0 or side > 1) return false;
 
-				RemovePiece(q);
-				RemovePiece(p);
-			} else {
-				p->setX(m.x2);
-				p->setY(m.y2);
-			}
-			piece_moves[i] = nullptr;
-			didmove = true;
-		}
+	// Neither side can have more pieces than there are tiles, which also keeps the counts in a byte.
+	const int tiles = MIN(w * (y + 1), 255);
+	int armies[2] = { 0, 0 };
+	for (Placement p : placed) {
+		armies[p.side]++;
 	}
-
-	if (didmove) {
-		passstate = 0;
-	} else {
-		if (passstate == 2) return;
-		passstate++;
+	for (int n : { p1p, p1k, p2p, p2k }) {
+		if (n < 0 or n > tiles) return false;
 	}
+	if (armies[1] + p1p + p1k > tiles or armies[0] + p2p + p2k > tiles) return false;
 
-	selection = nullptr;
-	turn = !turn;
-	reinstate = 0;
+	Clear();
+	if (w != width or y + 1 != height) ResetTextures();
 
-	this->position_history += summary() + '\n';
-}
+	this->width = w;
+	this->height = y + 1;
+	this->rules = RulesFor(width, height);
+	this->selection = nullptr;
+	this->reinstate = 0;
 
-std::vector<Turn> Board::possibleTurns() {
-	std::vector<Turn> turns;
+	this->position = { };
+	this->position.width = width;
+	this->position.height = height;
+	this->position.pass = pass;
+	this->position.turn = (side != 0);
 
-	// Pass - not considered by the AI
-	/*
-	 if (passstate < 2) {
-	 Turn t;
-	 t.move_count = 0;
-	 t.flags = TURN_MOVE;
-	 turns.push_back(t);
-	 }
-	 */
-
-	// Captures
-	for (unsigned i = 0; i < pieces.size(); i++) {
-		if (pieces[i]->getSide() != turn) continue;
-
-		std::vector<Move> pmoves = pieces[i]->getLegalMoves(true);
-
-		for (Move m : pmoves) {
-			Piece* q = pieceAt(m.x2, m.y2);
-			if (q == nullptr) continue;
-			if (q->getSide() == turn) continue;
-			if (!q->canCapture()) continue;
-
-			Turn t;
-			t.move_count = 1;
-			t.moves[0] = m;
-			t.flags = TURN_MOVE;
-			turns.push_back(t);
-		}
+	for (int i = 0; i < 3; i++) {
+		piece_moves[i] = nullptr;
 	}
 
-	// Reinforcements
-	for (int i = 0; i < width; i++) {
-		if (turn) {
-			if (!isEmpty(i, height - 1)) continue;
+	int white_pawns = 0, white_knights = 0, black_pawns = 0, black_knights = 0;
+	for (Placement p : placed) {
+		AddPiece(p.side, p.knight, p.x, p.y);
 
-			if (p1_knights > 0) {
-				Turn t;
-				t.move_count = 1;
-				t.moves[0] = {-1, -1, i, height - 1};
-				t.flags = TURN_REINFORCE | TURN_REINFORCE_KNIGHT;
-				turns.push_back(t);
-			}
-			if (p1_pawns > 0) {
-				Turn t;
-				t.move_count = 1;
-				t.moves[0] = {-1, -1, i, height - 1};
-				t.flags = TURN_REINFORCE;
-				turns.push_back(t);
-			}
+		if (p.side) {
+			if (p.knight) white_knights++;
+			else white_pawns++;
 		} else {
-			if (!isEmpty(i, 0)) continue;
-
-			if (p2_knights > 0) {
-				Turn t;
-				t.move_count = 1;
-				t.moves[0] = {-1, -1, i, 0};
-				t.flags = TURN_REINFORCE | TURN_REINFORCE_KNIGHT;
-				turns.push_back(t);
-			}
-			if (p2_pawns > 0) {
-				Turn t;
-				t.move_count = 1;
-				t.moves[0] = {-1, -1, i, 0};
-				t.flags = TURN_REINFORCE;
-				turns.push_back(t);
-			}
+			if (p.knight) black_knights++;
+			else black_pawns++;
 		}
 	}
 
-	// Moves
-	for (unsigned i = 0; i < pieces.size(); i++) {
-		if (pieces[i]->getSide() != turn) continue;
-
-		std::vector<Move> pmoves = pieces[i]->getLegalMoves(false);
-
-		for (unsigned j = 0; j < i; j++) {
-			if (pieces[j]->getSide() != turn) continue;
-
-			std::vector<Move> qmoves = pieces[j]->getLegalMoves(false);
-
-			for (unsigned k = 0; k < j; k++) {
-				if (pieces[k]->getSide() != turn) continue;
+	SetReserves(p1p, p1k, p2p, p2k);
 
-				std::vector<Move> rmoves = pieces[k]->getLegalMoves(false);
+	// The notation has no capture counters, assume both sides started with the classical army.
+	this->position.captures[1][0] = MAX(0, DEFAULT_PAWNS - black_pawns - p2p);
+	this->position.captures[1][1] = MAX(0, DEFAULT_KNIGHTS - black_knights - p2k);
+	this->position.captures[0][0] = MAX(0, DEFAULT_PAWNS - white_pawns - p1p);
+	this->position.captures[0][1] = MAX(0, DEFAULT_KNIGHTS - white_knights - p1k);
 
-				for (Move m : pmoves) {
-					for (Move n : qmoves) {
-						if (m.x2 == n.x2 and m.y2 == n.y2) continue;
+	this->position_history = "";
+	this->hash_history.clear();
+	this->start_position = this->summary();
+	this->turn_history.clear();
 
-						for (Move l : rmoves) {
-							if (m.x2 == l.x2 and m.y2 == l.y2) continue;
-							if (n.x2 == l.x2 and n.y2 == l.y2) continue;
+	return true;
+}
 
-							Turn t;
-							t.move_count = 3;
-							t.moves[0] = m;
-							t.moves[1] = n;
-							t.moves[2] = l;
-							t.flags = TURN_MOVE;
-							turns.push_back(t);
-						}
-					}
-				}
-			}
+bool Board::LoadGame(std::string filename) {
+	std::FILE* pFile = std::fopen(filename.c_str(), "r");
+	if (pFile == nullptr) return false;
 
-			for (Move m : pmoves) {
-				for (Move n : qmoves) {
-					if (m.x2 == n.x2 and m.y2 == n.y2) continue;
+	std::string history, last;
+	char line[1024];
 
-					Turn t;
-					t.move_count = 2;
-					t.moves[0] = m;
-					t.moves[1] = n;
-					t.flags = TURN_MOVE;
-					turns.push_back(t);
-				}
-			}
+	while (std::fgets(line, sizeof(line), pFile) != nullptr) {
+		std::string l(line);
+		while (!l.empty() and (l.back() == '\n' or l.back() == '\r')) {
+			l.pop_back();
 		}
 
-		for (Move m : pmoves) {
-			Turn t;
-			t.move_count = 1;
-			t.moves[0] = m;
-			t.flags = TURN_MOVE;
-			turns.push_back(t);
-		}
+		if (l.empty()) continue;
+		history += l + '\n';
+		last = l;
 	}
 
-	return turns;
-}
-
-double AlphaBetaPrune(Board* board, int depth, double alpha, double beta, std::vector<std::pair<std::size_t, double>>& hashtable) {
-	std::vector<Turn> turns = board->possibleTurns();
-
-	if (depth == 0 or turns.size() == 0 or board->WinState() != WINSTATE_NONE) return board->Evaluate();
-
-	double val, wal;
-	Board* b;
-
-	if (board->getTurn()) {
-		val = -1000.0;
-
-		for (unsigned j = 0; j < turns.size(); j++) {
-			b = new Board(board, turns[j]);
-			std::size_t hash = b->hash();
-			bool found = false;
+	std::fclose(pFile);
 
-			for (std::pair<std::size_t, double> pp : hashtable) {
-				if (pp.first == hash) {
-					found = true;
-					wal = pp.second;
-					break;
-				}
-			}
+	if (!LoadPosition(last)) return false;
 
-			if (!found) {
-				wal = AlphaBetaPrune(b, depth - 1, alpha, beta, hashtable);
-				hashtable.push_back(std::make_pair(hash, wal));
-			}
-			delete b;
+	// Repetitions are counted on position hashes, so those are needed for the whole game.
+	std::vector<std::uint64_t> hashes;
+	Board b(width, height);
+	std::stringstream ss(history);
+	std::string l;
 
-			if (wal > val) val = wal;
-			if (val > alpha) alpha = val;
-			if (alpha >= beta) break;
-		}
-	} else {
-		val = +1000.0;
-
-		for (unsigned j = 0; j < turns.size(); j++) {
-			b = new Board(board, turns[j]);
-			std::size_t hash = b->hash();
-			bool found = false;
-
-			for (std::pair<std::size_t, double> pp : hashtable) {
-				if (pp.first == hash) {
-					found = true;
-					wal = pp.second;
-					break;
-				}
-			}
-
-			if (!found) {
-				wal = AlphaBetaPrune(b, depth - 1, alpha, beta, hashtable);
-				hashtable.push_back(std::make_pair(hash, wal));
-			}
-			delete b;
-
-			if (wal < val) val = wal;
-			if (val < beta) beta = val;
-			if (alpha >= beta) break;
-		}
+	while (std::getline(ss, l, '\n')) {
+		if (b.LoadPosition(l)) hashes.push_back(b.position.hash());
 	}
 
-	return val;
+	this->position_history = history;
+	this->hash_history = hashes;
+	return true;
 }
 
-double PrincipalVariationPrune(Board* board, int depth, double alpha, double beta, int color) {
-	std::vector<Turn> turns = board->possibleTurns();
-	if (depth == 0 or turns.size() == 0) return board->Evaluate() * color;
-
-	Board* b = new Board(board, turns[0]);
-	double score = -PrincipalVariationPrune(b, depth - 1, -beta, -alpha, -color);
-	delete b;
+void Board::SaveGame(std::string filename) {
+	std::FILE* pFile = std::fopen(filename.c_str(), "w");
+	if (pFile == nullptr) return;
 
-	for (unsigned i = 1; i < turns.size(); i++) {
-		Board* b = new Board(board, turns[i]);
-		score = -PrincipalVariationPrune(b, depth - 1, -alpha - 1, -alpha, -color);
-		if (alpha < score and score < beta) {
-			score = -PrincipalVariationPrune(b, depth - 1, -beta, -score, -color);
-		}
+	std::fputs(position_history.c_str(), pFile);
+	std::fclose(pFile);
+}
 
-		delete b;
-		if (score > alpha) alpha = score;
-		if (alpha >= beta) break;
+void Board::Clear() {
+	while (!pieces.empty()) {
+		Piece* p = pieces.back();
+		pieces.pop_back();
+		delete p;
 	}
 
-	return alpha;
+	position.white = { };
+	position.black = { };
+	position.knights = { };
+	overlay_stale = true;
 }
 
-void Board::ComputeTurn(int depth = 0) {
-	// We shuffle the list of pieces to make sure the moves list is not hard dependent on the piece ordering every time
-	//static std::random_device rd;
-	//static std::mt19937 gen(rd());
-	//std::shuffle(pieces.begin(), pieces.end(), gen);
+void Board::AddPiece(bool side, bool knight, int x, int y) {
+	int sq = position.tile(x, y);
+	(side ? position.white : position.black).set(sq);
+	if (knight) position.knights.set(sq);
 
-	// Minmax algorithm with AB-pruning
-	std::vector<Turn> turns = possibleTurns();
+	pieces.push_back(new Piece(this, side, knight, x, y));
+	overlay_stale = true;
+}
 
-	printf("Damn, I can do %lu things!\n", turns.size());
-	unsigned start = SDL_GetTicks();
+void Board::SetReserves(int p1_pawns, int p1_knights, int p2_pawns, int p2_knights) {
+	this->position.reserves[1][0] = p1_pawns;
+	this->position.reserves[1][1] = p1_knights;
+	this->position.reserves[0][0] = p2_pawns;
+	this->position.reserves[0][1] = p2_knights;
+}
 
-	// Random move picker
-	/*
-	 static std::random_device rd;
-	 static std::mt19937 gen(rd());
-	 std::uniform_int_distribution<> rng(0, turns.size() - 1);
+// Rebuilds the pieces from the position, in the order of their tiles.
+void Board::Sync() {
+	while (!pieces.empty()) {
+		Piece* p = pieces.back();
+		pieces.pop_back();
+		delete p;
+	}
 
-	 Turn t = turns[rng(gen)];
-	 for (int i = 0; i < t.move_count; i++) {
-	 piece_moves[i] = pieceAt(t.moves[i].x1, t.moves[i].y1);
-	 this->moves[i] = t.moves[i];
-	 }
+	(position.white | position.black).forEach([this](int sq) {
+		pieces.push_back(new Piece(this, position.white.test(sq), position.knights.test(sq), sq % width, sq / width));
+	});
 
-	 printf("Picked random move!\n");
-	 */
+	overlay_stale = true;
+}
 
-	double val, wal;
-	unsigned bt = -1;
-	Board* b;
+void Board::UpdateOverlays() {
+	overlay_moves = { };
+	overlay_captures = { };
 
-	if (depth <= -1) depth = (-depth) - std::round(std::log10(turns.size()));
-	if (depth <= 0) depth = 1;
+	if (selection != nullptr) {
+		Move m[STEP_COUNT];
+		int n = rules->legalMoves(position, selection->getX(), selection->getY(), true, m);
+		for (int i = 0; i < n; i++) {
+			overlay_moves.set(position.tile(m[i].x2, m[i].y2));
+		}
+	}
 
-	printf("Evaluating moves up to depth %d.\n", depth);
+	(position.turn ? position.black : position.white).forEach([this](int sq) {
+		if (rules->canCapture(position, sq % width, sq / width)) overlay_captures.set(sq);
+	});
 
-	double alpha = -1000.0;
-	double beta = +1000.0;
-	std::vector<std::pair<std::size_t, double>> hashtable;
-	const unsigned k = (unsigned) 100;
+	overlay_selection = selection;
+	overlay_stale = false;
+}
 
-	if (turn) {
-		val = -1000.0;
+bool Board::isEmpty(int x, int y) {
+	if (x < 0 or y < 0 or x >= width or y >= height) return true;
 
-		for (unsigned j = 0; j < turns.size(); j++) {
-			b = new Board(this, turns[j]);
-			std::size_t hash = b->hash();
-			bool found = false;
+	return not position.occupied(position.tile(x, y));
+}
 
-			for (std::pair<std::size_t, double> pp : hashtable) {
-				if (pp.first == hash) {
-					found = true;
-					wal = pp.second;
-					break;
-				}
-			}
+Piece* Board::pieceAt(int x, int y) {
+	if (isEmpty(x, y)) return nullptr;
 
-			if (!found) {
-				wal = AlphaBetaPrune(b, depth - 1, alpha, beta, hashtable);
-				hashtable.push_back(std::make_pair(b->hash(), wal));
-			}
-			delete b;
+	for (Piece* p : this->pieces) {
+		if (p->getX() == x and p->getY() == y) {
+			return p;
+		}
+	}
+
+	return nullptr;
+}
 
-			if (j > 0 and j % k == 0) printf("[%u/%lu] %.1f s (%lu hashes)\n", j, turns.size(), ((0.001 * (turns.size() - j) / turns.size()) * (SDL_GetTicks() - start)), hashtable.size());
+void Board::ChangeTurn() {
+	Turn played;
+	played.move_count = 0;
+	played.flags = TURN_MOVE;
 
-			if (wal > val) {
-				val = wal;
-				bt = j;
-			}
-			if (val > alpha) alpha = val;
-			if (alpha >= beta) break;
-		}
+	if (reinstate > 0) {
+		played.move_count = 1;
+		played.flags = TURN_REINFORCE | (reinstate == 2 ? TURN_REINFORCE_KNIGHT : 0);
+		played.moves[0] = moves[0];
 	} else {
-		val = +1000.0;
-
-		for (unsigned j = 0; j < turns.size(); j++) {
-			b = new Board(this, turns[j]);
-			std::size_t hash = b->hash();
-			bool found = false;
-
-			for (std::pair<std::size_t, double> pp : hashtable) {
-				if (pp.first == hash) {
-					found = true;
-					wal = pp.second;
-					break;
-				}
+		for (int i = 0; i < 3; i++) {
+			if (piece_moves[i] == nullptr) {
+				continue;
 			}
 
-			if (!found) {
-				wal = AlphaBetaPrune(b, depth - 1, alpha, beta, hashtable);
-				hashtable.push_back(std::make_pair(b->hash(), wal));
-			}
-			delete b;
+			played.moves[(int) played.move_count] = moves[i];
+			played.move_count++;
+		}
+	}
 
-			if (j > 0 and j % k == 0) printf("[%u/%lu] %.1f s (%lu hashes)\n", j, turns.size(), ((0.001 * (turns.size() - j) / turns.size()) * (SDL_GetTicks() - start)), hashtable.size());
+	if (!rules->PlayTurn(position, played)) return;
+	Sync();
 
-			if (wal < val) {
-				val = wal;
-				bt = j;
-			}
-			if (val < beta) beta = val;
-			if (alpha >= beta) break;
-		}
+	for (int i = 0; i < 3; i++) {
+		piece_moves[i] = nullptr;
 	}
 
-	printf("It took me %.1f seconds to compute my move.\n", (0.001 * (SDL_GetTicks() - start)));
+	selection = nullptr;
+	reinstate = 0;
+
+	this->position_history += summary() + '\n';
+	this->hash_history.push_back(position.hash());
+	this->turn_history.push_back(played);
+}
 
-	Turn t = turns[bt];
-	for (int i = 0; i < t.move_count; i++) {
-		piece_moves[i] = pieceAt(t.moves[i].x1, t.moves[i].y1);
-		this->moves[i] = t.moves[i];
+void Board::PlayTurn(Turn t) {
+	for (int i = 0; i < 3; i++) {
+		piece_moves[i] = nullptr;
 	}
 
-	if ((reinstate = (t.flags & (TURN_REINFORCE | TURN_REINFORCE_KNIGHT)))) {
-		printf("Reinforcements arriving at (%d,%d).\n", t.moves[0].x2, t.moves[0].y2);
+	reinstate = 0;
+	if (t.flags & TURN_REINFORCE) {
+		reinstate = (t.flags & TURN_REINFORCE_KNIGHT) ? 2 : 1;
+		moves[0] = t.moves[0];
+	} else {
+		for (int i = 0; i < t.move_count; i++) {
+			piece_moves[i] = pieceAt(t.moves[i].x1, t.moves[i].y1);
+			moves[i] = t.moves[i];
+		}
 	}
 
 	ChangeTurn();
 }
 
-int Board::WinState() {
-	std::vector<std::pair<std::string, int>> checklist;
-	std::stringstream ss(position_history);
-	std::string line;
-	bool found;
-
-	while (std::getline(ss, line, '\n')) {
-		found = false;
-		for (std::pair<std::string, int> pp : checklist) {
-			if (pp.first == line) {
-				found = true;
-				if (++pp.second >= 3) {
-					return WINSTATE_DRAW; // draw by repetition.
-				}
+std::vector<Turn> Board::possibleTurns() {
+	// Passing is not considered by the AI.
+	std::vector<Turn> turns;
+	rules->possibleTurns(position, turns);
+	return turns;
+}
 
-				break;
-			}
-		}
+void Board::ComputeTurn(Engine& engine, int depth = 0) {
+	SearchResult r = engine.Search(this, depth);
 
-		if (!found) {
-			checklist.push_back(std::make_pair(line, 1));
-		}
+	if (!r.found) {
+		printf("I have no legal turns left!\n");
+		return;
 	}
 
-	// No draw by threefold repetition...
-	// checking for pieces < 4 or no pieces on board.
-	int white = 0, black = 0;
-	for (Piece* p : pieces) {
-		if (p->getSide()) white++;
-		else black++;
+	if (r.turn.flags & TURN_REINFORCE) {
+		printf("Reinforcements arriving at (%d,%d).\n", r.turn.moves[0].x2, r.turn.moves[0].y2);
 	}
 
-	if (white == 0 or white + p1_pawns + p1_knights < 4) return WINSTATE_BLACK; // black wins
-	else if (black == 0 or black + p2_pawns + p2_knights < 4) return WINSTATE_WHITE; // white wins.
-
-	// Final check: see if either side is capable of making moves.
-	found = turn;
+	PlayTurn(r.turn);
+}
 
-	// doing this in a messy way to avoid having to program in more checks/variables
-	turn = true;
-	white = WINSTATE_NONE; // undecided
-	if (possibleTurns().size() == 0) white = WINSTATE_BLACK;
-	else {
-		turn = false;
-		if (possibleTurns().size() == 0) white = WINSTATE_WHITE;
+int Board::WinState() {
+	std::unordered_map<std::uint64_t, int> seen;
+	for (std::uint64_t h : hash_history) {
+		if (++seen[h] >= 3) {
+			return WINSTATE_DRAW; // draw by repetition.
+		}
 	}
-	turn = found;
-	return white;
+
+	return rules->WinState(position);
 }
 
 double Board::Evaluate() {
-	static std::random_device rd;
-	static std::mt19937 gen(rd());
-	static std::normal_distribution<double> d(0.0, EVAL_DISPERSION);
+	return Evaluate(EvalParams());
+}
 
+double Board::Evaluate(const EvalParams& params) {
 	int state = WinState();
 
 	switch (state) {
@@ -651,75 +459,28 @@ double Board::Evaluate() {
 			break;
 	}
 
-	double score = PAWN_RESERVE_VALUE * (p1_pawns - p2_pawns) + KNIGHT_RESERVE_VALUE * (p1_knights - p2_knights);
-	score += PAWN_CAPTURE_VALUE * (p1_pawns_c - p2_pawns_c) + KNIGHT_CAPTURE_VALUE * (p1_knights_c - p2_knights_c);
-
-	for (Piece* p : this->pieces) {
-		if (p->getSide()) {
-			score += p->Evaluate();
-		} else {
-			score -= p->Evaluate();
-		}
-	}
-
-	return score + d(gen);
+	return rules->Evaluate(position, params);
 }
 
-void Board::RemovePiece(Piece* p) {
-	if (p != nullptr) {
-		pieces.erase(std::remove(pieces.begin(), pieces.end(), p), pieces.end());
-		delete p;
-	}
-
-	pieces.shrink_to_fit();
-}
-
-void Board::Render(SDL_Renderer* context) {
-	for (int i = 0; i < this->width; i++) {
-		for (int j = 0; j < this->height; j++) {
-			SDL_Rect tgt = { (int) (i * TEX_WIDTH), (int) (j * TEX_HEIGHT), (int) TEX_WIDTH, (int) TEX_HEIGHT };
-
-			if ((i % 2) == (j % 2)) {
-				SDL_SetRenderDrawColor(context, 250, 250, 220, 255);
-			} else {
-				SDL_SetRenderDrawColor(context, 150, 80, 30, 255);
-			}
-
-			SDL_RenderFillRect(context, &tgt);
-		}
-	}
-
-	int mx, my;
-	unsigned state = SDL_GetMouseState(&mx, &my);
-
-	mx -= mx % TEX_WIDTH;
-	my -= my % TEX_HEIGHT;
-
-	int tx = mx / TEX_WIDTH;
-	int ty = my / TEX_HEIGHT;
-
-	static bool lastpress = false;
-	bool press = (state & SDL_BUTTON(SDL_BUTTON_LEFT));
-	bool right = (state & SDL_BUTTON(SDL_BUTTON_RIGHT));
-
+void Board::Click(int tx, int ty, bool right) {
 	if (right) {
 		selection = nullptr;
-	} else if (press and not lastpress) {
+	} else {
 		Piece* p = pieceAt(tx, ty);
 
 		if (selection == nullptr) {
 			if (p != nullptr) {
-				if (p->getSide() == turn) {
+				if (p->getSide() == getTurn()) {
 					selection = p;
 				}
 			} else {
 				// empty tile click, attempt to reinforce.
-				if (turn and ty == height - 1) {
-					if (p1_pawns > 0 and reinstate == 0) {
+				if (getTurn() and ty == height - 1) {
+					if (getPawns(true) > 0 and reinstate == 0) {
 						reinstate = 1;
 						moves[0] = {0, 0, tx, ty};
 					}
-					else if (p1_knights > 0 and (reinstate == 1 or p1_pawns == 0)) {
+					else if (getKnights(true) > 0 and (reinstate == 1 or getPawns(true) == 0)) {
 						reinstate = 2;
 						moves[0] = {0, 0, tx, ty};
 					}
@@ -727,11 +488,11 @@ void Board::Render(SDL_Renderer* context) {
 						reinstate = 0;
 					}
 				} else if (ty == 0) {
-					if (p2_pawns > 0 and reinstate == 0) {
+					if (getPawns(false) > 0 and reinstate == 0) {
 						reinstate = 1;
 						moves[0] = {0, 0, tx, ty};
 					}
-					else if (p2_knights > 0 and (reinstate == 1 or p2_pawns == 0)) {
+					else if (getKnights(false) > 0 and (reinstate == 1 or getPawns(false) == 0)) {
 						reinstate = 2;
 						moves[0] = {0, 0, tx, ty};
 					}
@@ -750,7 +511,7 @@ void Board::Render(SDL_Renderer* context) {
 		} else {
 			if (p != nullptr) {
 				if (selection == p) selection = nullptr;
-				else if (p->getSide() == turn) selection = p;
+				else if (p->getSide() == getTurn()) selection = p;
 				else if (selection->isLegalMove(tx, ty, true)) {
 					// capturing
 					moves[0] = {selection->getX(), selection->getY(), tx, ty};
@@ -796,84 +557,99 @@ void Board::Render(SDL_Renderer* context) {
 			}
 		}
 	}
+}
+
+// The checkerboard, which only has to be drawn once.
+void Board::RenderTiles(SDL_Renderer* context) {
+	for (int i = 0; i < this->width; i++) {
+		for (int j = 0; j < this->height; j++) {
+			SDL_Rect tgt = { (int) (i * TEX_WIDTH), (int) (j * TEX_HEIGHT), (int) TEX_WIDTH, (int) TEX_HEIGHT };
+
+			if ((i % 2) == (j % 2)) {
+				SDL_SetRenderDrawColor(context, 250, 250, 220, 255);
+			} else {
+				SDL_SetRenderDrawColor(context, 150, 80, 30, 255);
+			}
+
+			SDL_RenderFillRect(context, &tgt);
+		}
+	}
+}
 
-	lastpress = press;
+void Board::ResetTextures() {
+	if (background != nullptr) SDL_DestroyTexture(background);
+	background = nullptr;
+}
 
-	SDL_Rect r, s;
-	r.x = mx;
-	r.y = my;
-	r.w = TEX_WIDTH;
-	r.h = TEX_HEIGHT;
+void Board::Render(SDL_Renderer* context) {
+	if (background == nullptr) {
+		background = SDL_CreateTexture(context, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, renderWidth(), renderHeight());
 
-	s.x = 0;
-	s.y = 0;
-	s.w = TEX_WIDTH;
-	s.h = TEX_HEIGHT;
+		if (background != nullptr) {
+			SDL_SetRenderTarget(context, background);
+			RenderTiles(context);
+			SDL_SetRenderTarget(context, nullptr);
+		}
+	}
 
-	int a = (int) (128.0 + 100.0 * sin(2.0 * PI * SDL_GetTicks() / 5000.0));
-	SDL_SetRenderDrawBlendMode(context, SDL_BLENDMODE_BLEND);
-	SDL_SetTextureColorMod(tex_selections, 255, 255, 255);
-	SDL_SetTextureAlphaMod(tex_selections, a);
-	SDL_RenderCopy(context, tex_selections, &s, &r);
-//SDL_SetRenderDrawColor(context, 255, 255, 255, a);
-//SDL_RenderFillRect(context, &r);
+	if (background != nullptr) SDL_RenderCopy(context, background, nullptr, nullptr);
+	else RenderTiles(context);
 
-	if (selection != nullptr) {
-		r.x = selection->getX() * TEX_WIDTH;
-		r.y = selection->getY() * TEX_HEIGHT;
-		r.w = TEX_WIDTH;
-		r.h = TEX_HEIGHT;
+	if (overlay_stale or overlay_selection != selection) UpdateOverlays();
+
+	int mx, my;
+	SDL_GetMouseState(&mx, &my);
+
+	auto tile = [](int x, int y) {
+		SDL_Rect r = { x * TEX_WIDTH, y * TEX_HEIGHT, TEX_WIDTH, TEX_HEIGHT };
+		return r;
+	};
+
+	// One batch per texture, drawn in this order.
+	SpriteBatch fills(nullptr), selections(tex_selections), figures(tex_pieces), markers(tex_selections);
+	SDL_Rect s = { 0, 0, TEX_WIDTH, TEX_HEIGHT };
 
-		SDL_SetTextureColorMod(tex_selections, 0, 100, 0);
-		SDL_SetTextureAlphaMod(tex_selections, 255);
-		SDL_RenderCopy(context, tex_selections, &s, &r);
+	Uint8 a = (Uint8) (128.0 + 100.0 * sin(2.0 * PI * SDL_GetTicks() / 5000.0));
+	selections.Add(s, tile(mx / TEX_WIDTH, my / TEX_HEIGHT), { 255, 255, 255, a });
+
+	if (selection != nullptr) {
+		selections.Add(s, tile(selection->getX(), selection->getY()), { 0, 100, 0, 255 });
 
 		for (int i = 0; i < width; i++) {
 			for (int j = 0; j < height; j++) {
 				if (i == selection->getX() and j == selection->getY()) continue;
 
-				r.x = i * TEX_WIDTH;
-				r.y = j * TEX_HEIGHT;
-				r.w = TEX_WIDTH;
-				r.h = TEX_HEIGHT;
-
-				if (selection->isLegalMove(i, j, true)) {
-					SDL_SetTextureColorMod(tex_selections, 0, 100, 0);
-					SDL_SetTextureAlphaMod(tex_selections, 150);
-					s = {TEX_WIDTH, 0, TEX_WIDTH, TEX_HEIGHT};
-					SDL_RenderCopy(context, tex_selections, &s, &r);
+				if (overlay_moves.test(position.tile(i, j))) {
+					selections.Add( { TEX_WIDTH, 0, TEX_WIDTH, TEX_HEIGHT }, tile(i, j), { 0, 100, 0, 150 });
 				} else {
-					SDL_SetRenderDrawColor(context, 70, 70, 70, 150);
-					SDL_RenderFillRect(context, &r);
+					fills.Add(s, tile(i, j), { 70, 70, 70, 150 });
 				}
 			}
 		}
 	}
 
 	if (reinstate != 0) {
-		SDL_SetTextureAlphaMod(tex_pieces, 150);
-		r.x = moves[0].x2 * TEX_WIDTH;
-		r.y = moves[0].y2 * TEX_HEIGHT;
-		r.w = TEX_WIDTH;
-		r.h = TEX_HEIGHT;
-		s = {(reinstate == 2 ? 0 : TEX_WIDTH), (turn ? TEX_HEIGHT : 0), TEX_WIDTH, TEX_HEIGHT};
-		SDL_RenderCopy(context, tex_pieces, &s, &r);
+		SDL_Rect r = { (reinstate == 2 ? 0 : TEX_WIDTH), (getTurn() ? TEX_HEIGHT : 0), TEX_WIDTH, TEX_HEIGHT };
+		figures.Add(r, tile(moves[0].x2, moves[0].y2), { 255, 255, 255, 150 });
 	}
 
-	SDL_SetTextureAlphaMod(tex_pieces, 255);
 	for (Piece* p : this->pieces) {
-		p->Render(context, turn);
+		p->Render(figures, markers, overlay_captures.test(position.tile(p->getX(), p->getY())));
 	}
 
-	SDL_SetTextureColorMod(tex_selections, 0, 100, 0);
-	SDL_SetTextureAlphaMod(tex_selections, 150);
 	for (int i = 0; i < 3; i++) {
 		if (this->piece_moves[i] != nullptr) {
 			Move m = moves[i];
 
-			RenderArrow(context, m.x1 * TEX_WIDTH, m.y1 * TEX_HEIGHT, m.x2 * TEX_WIDTH, m.y2 * TEX_HEIGHT);
+			AddArrow(markers, m.x1 * TEX_WIDTH, m.y1 * TEX_HEIGHT, m.x2 * TEX_WIDTH, m.y2 * TEX_HEIGHT, { 0, 100, 0, 150 });
 		}
 	}
+
+	SDL_SetRenderDrawBlendMode(context, SDL_BLENDMODE_BLEND);
+	fills.Flush(context);
+	selections.Flush(context);
+	figures.Flush(context);
+	markers.Flush(context);
 }
 
 int Board::renderWidth() {
@@ -890,8 +666,10 @@ std::string Board::summary() {
 	int j = 0;
 	for (int y = 0; y < height; y++) {
 		for (int x = 0; x < width; x++) {
-			Piece* p = pieceAt(x, y);
-			if (p == nullptr) {
+			int sq = y * width + x;
+			bool white = position.white.test(sq);
+
+			if (not position.occupied(sq)) {
 				j++;
 			} else {
 				if (j > 0) {
@@ -899,10 +677,8 @@ std::string Board::summary() {
 					j = 0;
 				}
 
-				if (p->getSide() and p->isKnight()) result += "K";
-				if (p->getSide() and !p->isKnight()) result += "P";
-				if (!p->getSide() and p->isKnight()) result += "k";
-				if (!p->getSide() and !p->isKnight()) result += "p";
+				bool knight = position.knights.test(sq);
+				result += (white ? (knight ? 'K' : 'P') : (knight ? 'k' : 'p'));
 			}
 		}
 
@@ -912,17 +688,23 @@ std::string Board::summary() {
 	}
 
 	result += ']';
-	result += ' ' + std::to_string(passstate);
-	result += ' ' + std::to_string(p1_pawns);
-	result += ' ' + std::to_string(p1_knights);
-	result += ' ' + std::to_string(p2_pawns);
-	result += ' ' + std::to_string(p2_knights);
-	result += ' ' + std::to_string((int) turn);
+	result += ' ' + std::to_string(position.pass);
+	result += ' ' + std::to_string(getPawns(true));
+	result += ' ' + std::to_string(getKnights(true));
+	result += ' ' + std::to_string(getPawns(false));
+	result += ' ' + std::to_string(getKnights(false));
+	result += ' ' + std::to_string(position.turn);
 
 	return result;
 }
 
-std::size_t Board::hash() {
-	static std::hash<std::string> hash_fn;
-	return hash_fn(this->summary());
+std::uint64_t Board::hash() {
+	// FNV-1a over the summary, so keys are stable across builds and can be stored in files.
+	std::uint64_t h = 14695981039346656037ull;
+	for (char c : summary()) {
+		h ^= (unsigned char) c;
+		h *= 1099511628211ull;
+	}
+
+	return h;
 }
@@ -1,46 +1,72 @@
 #ifndef BOARD_HPP
 #define BOARD_HPP
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include "defines.hpp"
+#include "position.hpp"
+#include "rules.hpp"
 
+class Engine;
 class Piece;
 
 class Board {
 	public:
 		Board(int width, int height);
+		Board(const WidePosition& position);
+		Board(Board* b);
 		Board(Board* b, Turn t);
 		~Board();
 
 		void NewGame(int pawns, int knights, int flanking);
 		void Clear();
+		void AddPiece(bool side, bool knight, int x, int y);
+		void SetReserves(int p1_pawns, int p1_knights, int p2_pawns, int p2_knights);
 		void Render(SDL_Renderer* context);
+		void Click(int x, int y, bool right);
+		void ResetTextures();
 		bool isEmpty(int x, int y);
 		Piece* pieceAt(int x, int y);
 
 		void ChangeTurn();
+		void PlayTurn(Turn t);
 
-		void ComputeTurn(int depth);
+		void ComputeTurn(Engine& engine, int depth);
 		double Evaluate();
+		double Evaluate(const EvalParams& params);
 		int WinState();
 		std::vector<Turn> possibleTurns();
 
-		void LoadGame(std::string filename);
+		bool LoadPosition(std::string summary);
+		bool LoadGame(std::string filename);
 		void SaveGame(std::string filename);
 
 	protected:
-		int width, height, passstate, reinstate;
-		std::vector<Piece*> pieces;
+		int width, height, reinstate;
+		WidePosition position;
+		std::vector<Piece*> pieces; // the pieces of position, for the interface
 		Piece** piece_moves;
 		Move* moves;
 		Piece* selection;
-		bool turn;
-		int p1_pawns, p1_knights, p1_pawns_c, p1_knights_c;
-		int p2_pawns, p2_knights, p2_pawns_c, p2_knights_c;
 		std::string position_history;
+		std::vector<std::uint64_t> hash_history; // position.hash() of every line in position_history
+		std::string start_position; // summary() of the first position, empty after NewGame
+		std::vector<Turn> turn_history;
 
-		void RemovePiece(Piece* p);
+		const Rules* rules;
+
+		// What Render highlights, recomputed only when the position or the selection changes.
+		Bitboard<BITBOARD_MAX_WORDS> overlay_moves; // tiles the selected piece can move to
+		Bitboard<BITBOARD_MAX_WORDS> overlay_captures; // pieces the side to move can capture
+		Piece* overlay_selection;
+		bool overlay_stale;
+
+		SDL_Texture* background; // the checkerboard, drawn by the first Render
+
+		void Sync();
+		void UpdateOverlays();
+		void RenderTiles(SDL_Renderer* context);
 
 	public:
 		inline int getWidth() {
@@ -51,14 +77,51 @@ class Board {
 		}
 
 		inline bool getTurn() {
-			return turn;
+			return position.turn;
+		}
+
+		inline void setTurn(bool turn) {
+			this->position.turn = turn;
+			this->overlay_stale = true;
+		}
+
+		inline int getPawns(bool side) {
+			return position.reserves[side][0];
+		}
+
+		inline int getKnights(bool side) {
+			return position.reserves[side][1];
+		}
+
+		inline const std::vector<Piece*>& getPieces() {
+			return pieces;
+		}
+
+		inline const Rules* getRules() {
+			return rules;
+		}
+
+		inline const WidePosition& getPosition() {
+			return position;
+		}
+
+		inline const std::vector<std::uint64_t>& getHashHistory() {
+			return hash_history;
+		}
+
+		inline const std::string& getStartPosition() {
+			return start_position;
+		}
+
+		inline const std::vector<Turn>& getTurnHistory() {
+			return turn_history;
 		}
 
 		int renderWidth();
 		int renderHeight();
 
 		std::string summary();
-		std::size_t hash();
+		std::uint64_t hash();
 };
 
 #endif // BOARD_HPP
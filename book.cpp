@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "book.hpp"
+#include "engine.hpp"
+#include "rules.hpp"
+
+Book book;
+
+Book::Book() {
+	this->map = nullptr;
+	this->length = 0;
+	this->entries = nullptr;
+	this->count = 0;
+	this->width = 0;
+	this->height = 0;
+}
+
+Book::~Book() {
+	Close();
+}
+
+bool Book::Open(std::string filename) {
+	Close();
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 or (std::size_t) st.st_size < sizeof(BookHeader)) {
+		close(fd);
+		return false;
+	}
+
+	void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (m == MAP_FAILED) return false;
+
+	const BookHeader* header = (const BookHeader*) m;
+	if (std::memcmp(header->magic, "SUTBOOK", 8) != 0 or header->version != BOOK_VERSION or sizeof(BookHeader) + header->count * sizeof(BookEntry) > (std::size_t) st.st_size) {
+		printf("%s is not a valid opening book.\n", filename.c_str());
+		munmap(m, st.st_size);
+		return false;
+	}
+
+	this->map = m;
+	this->length = st.st_size;
+	this->entries = (const BookEntry*) ((const char*) m + sizeof(BookHeader));
+	this->count = header->count;
+	this->width = header->width;
+	this->height = header->height;
+
+	return true;
+}
+
+void Book::Close() {
+	if (map != nullptr) {
+		munmap(map, length);
+	}
+
+	this->map = nullptr;
+	this->length = 0;
+	this->entries = nullptr;
+	this->count = 0;
+}
+
+std::uint64_t BookKey(Board* board, bool& mirrored) {
+	Board reflected(board->getPosition().mirror());
+	std::uint64_t key = board->hash(), other = reflected.hash();
+
+	mirrored = other < key;
+	return (mirrored ? other : key);
+}
+
+bool Book::Probe(Board* board, Turn& t) {
+	if (count == 0) return false;
+	if (board->getWidth() != width or board->getHeight() != height) return false;
+
+	bool mirrored;
+	std::uint64_t key = BookKey(board, mirrored);
+	const BookEntry* e = std::lower_bound(entries, entries + count, key, [](const BookEntry& a, std::uint64_t k) {
+		return a.key < k;
+	});
+
+	if (e == entries + count or e->key != key) return false;
+
+	t = UnpackTurn(e->turn);
+	if (mirrored) t = MirrorTurn(t, width);
+	return true;
+}
+
+struct BookJob {
+		WidePosition position;
+		BookEntry entry;
+		bool found;
+		std::vector<Turn> expand;
+};
+
+static void SearchBookJobs(std::vector<BookJob>& jobs, std::atomic<std::size_t>& next, int breadth, int depth) {
+	Engine engine;
+	engine.useBook = false;
+
+	std::size_t i;
+	while ((i = next++) < jobs.size()) {
+		BookJob& job = jobs[i];
+		Board board(job.position);
+		SearchResult r = engine.Search(&board, depth);
+
+		job.found = r.found;
+		if (!r.found) continue;
+
+		job.entry.key = board.hash();
+		job.entry.turn = PackTurn(r.turn);
+		job.entry.score = (float) r.score;
+		job.entry.depth = r.depth;
+		job.entry.reserved = 0;
+
+		// Expand along the best-scoring root turns for the side to move.
+		bool white = job.position.turn;
+		std::vector<std::pair<Turn, double>>& scores = engine.rootScores;
+		std::stable_sort(scores.begin(), scores.end(), [white](const std::pair<Turn, double>& a, const std::pair<Turn, double>& b) {
+			return white ? a.second > b.second : a.second < b.second;
+		});
+
+		job.expand.push_back(r.turn);
+		for (unsigned j = 0; j < scores.size() and (int) job.expand.size() < breadth; j++) {
+			if (!SameTurn(scores[j].first, r.turn)) job.expand.push_back(scores[j].first);
+		}
+	}
+}
+
+bool BuildBook(std::string filename, int plies, int breadth, int depth, int threads) {
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	if (breadth <= 0) breadth = 1;
+
+	Board root(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+	root.NewGame(DEFAULT_PAWNS, DEFAULT_KNIGHTS, DEFAULT_FLANKING);
+
+	const Rules* rules = root.getRules();
+	std::vector<WidePosition> frontier;
+	std::unordered_set<std::uint64_t> seen;
+	std::vector<BookEntry> entries;
+
+	// Positions are searched as the mirror image with the smaller key, so each pair is searched once.
+	bool mirrored;
+	seen.insert(BookKey(&root, mirrored));
+	frontier.push_back(mirrored ? root.getPosition().mirror() : root.getPosition());
+
+	unsigned start = SDL_GetTicks();
+
+	for (int ply = 0; ply < plies and !frontier.empty(); ply++) {
+		std::vector<BookJob> jobs(frontier.size());
+		for (unsigned i = 0; i < frontier.size(); i++) {
+			jobs[i].position = frontier[i];
+			jobs[i].found = false;
+		}
+
+		std::atomic<std::size_t> next(0);
+		std::vector<std::thread> workers;
+		for (int i = 0; i < threads; i++) {
+			workers.push_back(std::thread(SearchBookJobs, std::ref(jobs), std::ref(next), breadth, depth));
+		}
+		for (std::thread& w : workers) {
+			w.join();
+		}
+
+		frontier.clear();
+		for (BookJob& job : jobs) {
+			if (job.found) {
+				entries.push_back(job.entry);
+
+				if (ply + 1 < plies) {
+					for (Turn t : job.expand) {
+						WidePosition child = job.position;
+						rules->PlayTurn(child, t);
+
+						Board b(child);
+						if (seen.insert(BookKey(&b, mirrored)).second) frontier.push_back(mirrored ? child.mirror() : child);
+					}
+				}
+			}
+		}
+
+		printf("Ply %d: %lu positions searched, %.1f s elapsed.\n", ply + 1, jobs.size(), 0.001 * (SDL_GetTicks() - start));
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b) {
+		return a.key < b.key;
+	});
+
+	std::FILE* pFile = std::fopen(filename.c_str(), "wb");
+	if (pFile == nullptr) {
+		printf("Failed to open %s for writing.\n", filename.c_str());
+		return false;
+	}
+
+	BookHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "SUTBOOK", 8);
+	header.version = BOOK_VERSION;
+	header.width = DEFAULT_WIDTH;
+	header.height = DEFAULT_HEIGHT;
+	header.count = entries.size();
+
+	bool ok = std::fwrite(&header, sizeof(header), 1, pFile) == 1;
+	if (!entries.empty()) ok = ok and std::fwrite(entries.data(), sizeof(BookEntry), entries.size(), pFile) == entries.size();
+	ok = (std::fclose(pFile) == 0) and ok;
+
+	printf("Wrote %lu book positions to %s.\n", entries.size(), filename.c_str());
+	return ok;
+}
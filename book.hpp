@@ -0,0 +1,61 @@
+#ifndef BOOK_HPP
+#define BOOK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "defines.hpp"
+
+class Board;
+
+// On-disk layout: a BookHeader followed by `count` BookEntry records sorted by key.
+struct BookHeader {
+		char magic[8]; // "SUTBOOK"
+		std::uint32_t version;
+		std::uint16_t width, height;
+		std::uint64_t count;
+};
+
+struct BookEntry {
+		std::uint64_t key; // BookKey(), shared by a position and its mirror image
+		PackedTurn turn;
+		float score; // from white's point of view
+		std::uint16_t depth;
+		std::uint16_t reserved;
+};
+
+const std::uint32_t BOOK_VERSION = 2;
+
+class Book {
+	public:
+		Book();
+		~Book();
+
+		bool Open(std::string filename);
+		void Close();
+		bool Probe(Board* board, Turn& t);
+
+		inline std::size_t size() {
+			return count;
+		}
+
+	protected:
+		void* map;
+		std::size_t length;
+		const BookEntry* entries;
+		std::size_t count;
+		int width, height;
+};
+
+extern Book book;
+
+// The smaller Board::hash() of the board and its mirror image, with mirrored set if that is the
+// mirror image's. Turns in the book are stored for the position with that hash.
+std::uint64_t BookKey(Board* board, bool& mirrored);
+
+// Searches the positions reached by the `breadth` best turns of each side for the first `plies`
+// turns after NewGame to the given depth on `threads` threads and writes the results to filename.
+bool BuildBook(std::string filename, int plies, int breadth, int depth, int threads);
+
+#endif // BOOK_HPP
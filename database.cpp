@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "database.hpp"
+#include "record.hpp"
+#include "rules.hpp"
+
+GameDatabase::GameDatabase() {
+	this->map = nullptr;
+	this->length = 0;
+	this->gameList = nullptr;
+	this->store = nullptr;
+	this->entries = nullptr;
+	this->gameCount = 0;
+	this->storeBytes = 0;
+	this->count = 0;
+}
+
+GameDatabase::~GameDatabase() {
+	Close();
+}
+
+static std::size_t StoreSize(std::uint64_t turnBytes) {
+	return (turnBytes + 7) & ~(std::uint64_t) 7;
+}
+
+bool GameDatabase::Open(std::string filename) {
+	Close();
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 or (std::size_t) st.st_size < sizeof(DatabaseHeader)) {
+		close(fd);
+		return false;
+	}
+
+	void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (m == MAP_FAILED) return false;
+
+	const DatabaseHeader* header = (const DatabaseHeader*) m;
+	std::size_t needed = sizeof(DatabaseHeader) + header->games * sizeof(DatabaseGame) + StoreSize(header->turnBytes) + header->count * sizeof(DatabaseEntry);
+	if (std::memcmp(header->magic, "SUTGDB", 7) != 0 or header->version != DATABASE_VERSION or needed > (std::size_t) st.st_size) {
+		munmap(m, st.st_size);
+		return false;
+	}
+
+	// Queries jump around the index, there is nothing to gain from reading ahead.
+	madvise(m, st.st_size, MADV_RANDOM);
+
+	const char* base = (const char*) m + sizeof(DatabaseHeader);
+	this->map = m;
+	this->length = st.st_size;
+	this->gameList = (const DatabaseGame*) base;
+	this->store = (const unsigned char*) (base + header->games * sizeof(DatabaseGame));
+	this->entries = (const DatabaseEntry*) (base + header->games * sizeof(DatabaseGame) + StoreSize(header->turnBytes));
+	this->gameCount = header->games;
+	this->storeBytes = header->turnBytes;
+	this->count = header->count;
+
+	return true;
+}
+
+void GameDatabase::Close() {
+	if (map != nullptr) {
+		munmap(map, length);
+	}
+
+	this->map = nullptr;
+	this->length = 0;
+	this->gameList = nullptr;
+	this->store = nullptr;
+	this->entries = nullptr;
+	this->gameCount = 0;
+	this->storeBytes = 0;
+	this->count = 0;
+}
+
+void GameDatabase::Find(const WidePosition& p, std::vector<DatabaseHit>& hits) {
+	hits.clear();
+	if (count == 0) return;
+
+	std::uint64_t h = p.hash(), m = p.mirror().hash();
+	std::uint64_t key = (m < h ? m : h);
+	bool mirrored = m < h;
+
+	const DatabaseEntry* e = std::lower_bound(entries, entries + count, key, [](const DatabaseEntry& a, std::uint64_t k) {
+		return a.key < k;
+	});
+
+	for (; e != entries + count and e->key == key; e++) {
+		DatabaseHit hit;
+		hit.game = e->game;
+		hit.ply = e->ply;
+		hit.played = e->flags & DATABASE_TURN;
+		hit.turn = UnpackTurn(e->turn);
+		hit.result = e->result;
+
+		if (hit.played and ((e->flags & DATABASE_MIRRORED) != 0) != mirrored) hit.turn = MirrorTurn(hit.turn, p.width);
+		hits.push_back(hit);
+	}
+}
+
+bool GameDatabase::ReadGame(std::uint32_t index, RecordGame& game, std::vector<Turn>& turns) {
+	if (index >= gameCount) return false;
+
+	const DatabaseGame& g = gameList[index];
+	const unsigned char* p = store + g.offset;
+
+	game.width = g.width;
+	game.height = g.height;
+	game.start = std::string((const char*) p, g.startLength);
+	game.result = g.result;
+	p += g.startLength;
+
+	turns.clear();
+	for (unsigned i = 0; i < g.plies; i++) {
+		Turn t;
+		p += DecodeTurn(p, t);
+		turns.push_back(t);
+	}
+
+	return true;
+}
+
+static bool EntryOrder(const DatabaseEntry& a, const DatabaseEntry& b) {
+	if (a.key != b.key) return a.key < b.key;
+	return a.game != b.game ? a.game < b.game : a.ply < b.ply;
+}
+
+// Indexes every position of the games handed out by next into entries, sorted by key, game and ply.
+static void IndexGames(const std::vector<DatabaseGame>& games, const std::vector<unsigned char>& store, std::atomic<std::size_t>& next, std::atomic<unsigned long>& broken, std::vector<DatabaseEntry>& entries) {
+	std::size_t i;
+	while ((i = next++) < games.size()) {
+		const DatabaseGame& g = games[i];
+		const unsigned char* p = store.data() + g.offset;
+
+		RecordGame game;
+		game.width = g.width;
+		game.height = g.height;
+		game.start = std::string((const char*) p, g.startLength);
+		p += g.startLength;
+
+		Board board(game.width, game.height);
+		if (!SetupGame(game, &board)) {
+			broken++;
+			continue;
+		}
+
+		const Rules* rules = board.getRules();
+		WidePosition position = board.getPosition();
+
+		// Plies past what an entry can hold are stored, but not indexed.
+		unsigned plies = std::min<unsigned>(g.plies, 0xFFFF);
+		for (unsigned ply = 0; ply <= plies; ply++) {
+			std::uint64_t h = position.hash(), m = position.mirror().hash();
+
+			DatabaseEntry e;
+			e.key = (m < h ? m : h);
+			e.turn = 0;
+			e.game = i;
+			e.ply = ply;
+			e.flags = (m < h ? DATABASE_MIRRORED : 0);
+			e.result = g.result;
+
+			Turn t;
+			bool last = ply == g.plies;
+			if (!last) {
+				p += DecodeTurn(p, t);
+				e.turn = PackTurn(t);
+				e.flags |= DATABASE_TURN;
+			}
+
+			entries.push_back(e);
+			if (last or ply == plies) break;
+
+			if (!rules->PlayTurn(position, t)) {
+				broken++;
+				break;
+			}
+		}
+	}
+
+	std::sort(entries.begin(), entries.end(), EntryOrder);
+}
+
+bool BuildDatabase(std::string filename, std::vector<std::string> archives, int threads) {
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	unsigned start = SDL_GetTicks();
+
+	// Archives are read one after another into the turn store, which is all the workers need.
+	std::vector<DatabaseGame> games;
+	std::vector<unsigned char> store;
+	unsigned long plies = 0;
+
+	for (std::string archive : archives) {
+		RecordReader reader;
+		if (!reader.Open(archive)) {
+			printf("%s is not a game archive.\n", archive.c_str());
+			continue;
+		}
+
+		RecordGame game;
+		while (reader.NextGame(game)) {
+			DatabaseGame g;
+			std::memset(&g, 0, sizeof(g));
+			g.offset = store.size();
+			g.width = game.width;
+			g.height = game.height;
+			g.startLength = game.start.size();
+			store.insert(store.end(), game.start.begin(), game.start.end());
+
+			Turn t;
+			while (reader.NextTurn(t)) {
+				EncodeTurn(t, store);
+				g.plies++;
+			}
+
+			g.result = reader.getResult();
+			plies += g.plies;
+			games.push_back(g);
+		}
+	}
+
+	printf("Read %lu games with %lu plies in %.1f s.\n", games.size(), plies, 0.001 * (SDL_GetTicks() - start));
+
+	std::atomic<std::size_t> next(0);
+	std::atomic<unsigned long> broken(0);
+	std::vector<std::vector<DatabaseEntry>> parts(threads);
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.push_back(std::thread(IndexGames, std::cref(games), std::cref(store), std::ref(next), std::ref(broken), std::ref(parts[i])));
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	if (broken > 0) printf("%lu games have an unreadable start or an illegal turn, their index stops there.\n", broken.load());
+
+	// Every worker sorted its own share, so they only need to be merged.
+	std::vector<DatabaseEntry> entries;
+	for (std::vector<DatabaseEntry>& part : parts) {
+		std::size_t middle = entries.size();
+		entries.insert(entries.end(), part.begin(), part.end());
+		std::inplace_merge(entries.begin(), entries.begin() + middle, entries.end(), EntryOrder);
+		std::vector<DatabaseEntry>().swap(part);
+	}
+
+	std::FILE* pFile = std::fopen(filename.c_str(), "wb");
+	if (pFile == nullptr) {
+		printf("Failed to open %s for writing.\n", filename.c_str());
+		return false;
+	}
+
+	DatabaseHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "SUTGDB", 7);
+	header.version = DATABASE_VERSION;
+	header.games = games.size();
+	header.turnBytes = store.size();
+	header.count = entries.size();
+
+	// The index starts on an 8-byte boundary, so it can be used straight from the mapping.
+	store.resize(StoreSize(store.size()), 0);
+
+	bool ok = std::fwrite(&header, sizeof(header), 1, pFile) == 1;
+	if (!games.empty()) ok = ok and std::fwrite(games.data(), sizeof(DatabaseGame), games.size(), pFile) == games.size();
+	if (!store.empty()) ok = ok and std::fwrite(store.data(), 1, store.size(), pFile) == store.size();
+	if (!entries.empty()) ok = ok and std::fwrite(entries.data(), sizeof(DatabaseEntry), entries.size(), pFile) == entries.size();
+	ok = (std::fclose(pFile) == 0) and ok;
+
+	printf("Wrote %lu games and %lu indexed positions to %s in %.1f s.\n", games.size(), entries.size(), filename.c_str(), 0.001 * (SDL_GetTicks() - start));
+	return ok;
+}
+
+struct TurnStats {
+		Turn turn;
+		int count;
+		int results[4]; // by WINSTATE_*
+};
+
+bool QueryDatabase(std::string filename, std::string position) {
+	GameDatabase database;
+	if (!database.Open(filename)) {
+		printf("%s is not a game database.\n", filename.c_str());
+		return false;
+	}
+
+	Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+	if (!board.LoadPosition(position)) {
+		printf("Cannot read the position \"%s\".\n", position.c_str());
+		return false;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<DatabaseHit> hits;
+	database.Find(board.getPosition(), hits);
+
+	// A game that comes back to the position counts once towards the results, but every turn counts.
+	std::vector<TurnStats> stats;
+	int results[4] = { 0, 0, 0, 0 };
+	unsigned long games = 0, ended = 0;
+
+	for (unsigned i = 0; i < hits.size(); i++) {
+		const DatabaseHit& hit = hits[i];
+		if (i == 0 or hits[i - 1].game != hit.game) {
+			results[hit.result & 3]++;
+			games++;
+		}
+
+		if (!hit.played) {
+			ended++;
+			continue;
+		}
+
+		auto s = std::find_if(stats.begin(), stats.end(), [&hit](const TurnStats& s) {
+			return SameTurn(s.turn, hit.turn);
+		});
+
+		if (s == stats.end()) {
+			stats.push_back({ hit.turn, 0, { 0, 0, 0, 0 } });
+			s = stats.end() - 1;
+		}
+
+		s->count++;
+		s->results[hit.result & 3]++;
+	}
+
+	std::stable_sort(stats.begin(), stats.end(), [](const TurnStats& a, const TurnStats& b) {
+		return a.count > b.count;
+	});
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	printf("Found %lu times in %lu of %lu games (%d white wins, %d black wins, %d draws, %d unfinished) in %.3f ms.\n", hits.size(), games, database.games(), results[WINSTATE_WHITE], results[WINSTATE_BLACK], results[WINSTATE_DRAW], results[WINSTATE_NONE], ms);
+
+	for (const TurnStats& s : stats) {
+		printf("%s\t%d played, %d white wins, %d black wins, %d draws, %d unfinished\n", TurnString(s.turn).c_str(), s.count, s.results[WINSTATE_WHITE], s.results[WINSTATE_BLACK], s.results[WINSTATE_DRAW], s.results[WINSTATE_NONE]);
+	}
+
+	if (ended > 0) printf("Ended here %lu times.\n", ended);
+
+	if (!hits.empty()) {
+		printf("Games (ply):");
+		for (unsigned i = 0; i < hits.size() and i < (unsigned) DATABASE_GAMES_SHOWN; i++) {
+			printf(" %u (%d)", hits[i].game + 1, hits[i].ply);
+		}
+		printf(hits.size() > (unsigned) DATABASE_GAMES_SHOWN ? " ...\n" : "\n");
+	}
+
+	return true;
+}
@@ -0,0 +1,96 @@
+#ifndef DATABASE_HPP
+#define DATABASE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "defines.hpp"
+#include "position.hpp"
+
+struct RecordGame;
+
+// On-disk layout: a DatabaseHeader, `games` DatabaseGame records, the turn store of `turnBytes`
+// bytes (padded to 8) and `count` DatabaseEntry records sorted by key. The turn store holds, per
+// game, its summary() start position (if any) and then its plies in the archive encoding (see
+// record.hpp). The index has an entry for every position of every game, including the last one.
+struct DatabaseHeader {
+		char magic[8]; // "SUTGDB"
+		std::uint32_t version;
+		std::uint32_t reserved;
+		std::uint64_t games, turnBytes, count;
+};
+
+struct DatabaseGame {
+		std::uint64_t offset; // into the turn store
+		std::uint32_t plies;
+		std::uint16_t startLength; // 0 for a NewGame start
+		std::uint8_t width, height;
+		std::uint8_t result; // WINSTATE_*
+		std::uint8_t reserved[7];
+};
+
+struct DatabaseEntry {
+		std::uint64_t key; // BasicPosition::canonicalHash(), shared by a position and its mirror image
+		PackedTurn turn; // played from the position as it was in the game, see flags
+		std::uint32_t game;
+		std::uint16_t ply;
+		std::uint8_t flags; // DATABASE_*
+		std::uint8_t result; // of the game, so statistics need no second lookup
+};
+
+const std::uint32_t DATABASE_VERSION = 1;
+
+#define DATABASE_MIRRORED 0x01 // the game had the mirror image of the position with that key
+#define DATABASE_TURN 0x02 // a turn was played from the position, otherwise the game ended there
+
+// A position found in a game, oriented like the position that was looked up.
+struct DatabaseHit {
+		std::uint32_t game;
+		int ply;
+		bool played; // false if the game ended in the position
+		Turn turn;
+		int result;
+};
+
+class GameDatabase {
+	public:
+		GameDatabase();
+		~GameDatabase();
+
+		bool Open(std::string filename);
+		void Close();
+
+		// Every occurrence of p (or its mirror image) in the games, sorted by game and ply.
+		void Find(const WidePosition& p, std::vector<DatabaseHit>& hits);
+
+		// The start and turns of a game, to replay it with SetupGame().
+		bool ReadGame(std::uint32_t index, RecordGame& game, std::vector<Turn>& turns);
+
+		inline std::size_t games() {
+			return gameCount;
+		}
+
+		inline std::size_t size() {
+			return count;
+		}
+
+	protected:
+		void* map;
+		std::size_t length;
+		const DatabaseGame* gameList;
+		const unsigned char* store;
+		const DatabaseEntry* entries;
+		std::size_t gameCount, storeBytes, count;
+};
+
+// Replays the games of the archives on `threads` threads (all cores if 0) and writes their turns
+// and an index of every position they reach to filename.
+bool BuildDatabase(std::string filename, std::vector<std::string> archives, int threads);
+
+// Prints the games that reached the position with the given summary(), the turns played from it
+// with their results and the time the lookup took.
+bool QueryDatabase(std::string filename, std::string position);
+
+#endif // DATABASE_HPP
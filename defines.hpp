@@ -4,7 +4,6 @@
 struct SDL_Texture;
 
 #define PI 3.141592653589793
-#undef RANDOMIZE_UNITS
 
 # if SDL_BYTEORDER == SDL_BIG_ENDIAN
 
@@ -37,6 +36,7 @@ const unsigned SEPIA = 0xFF144678;// dark square color
 
 const int TEX_WIDTH = 60;
 const int TEX_HEIGHT = 60;
+const int FRAME_INTERVAL = 50; // milliseconds between redraws while the cursor is animating
 //const unsigned ARR_STRIFE = 10; // amount of pixels used from the arrow texture for stretching
 
 const int DEFAULT_WIDTH = 9; // classical: 9
@@ -59,9 +59,69 @@ const double KNIGHT_CAPTURE_VALUE = 3.2;
 const double CENTER_POSITION_VALUE = 0.02;
 const double MOVE_VALUE = 0.01;
 
-const double EVAL_DISPERSION = 0.01;
+const double EVAL_DISPERSION = 0.01; // noise on the scores of root turns, to vary between equal turns
+const unsigned EVAL_CACHE_ENTRIES = 1 << 16; // 16 bytes each, see evalcache.hpp
+
+// Children of the last ply before the leaves are evaluated in batches of this size, doubling up to the maximum.
+const unsigned FRONTIER_BATCH = 8;
+const unsigned FRONTIER_BATCH_MAX = 64;
+
+const unsigned TACTICS_TIME = 5000; // milliseconds per position of a tactical suite, see tactics.hpp
+
+const int HASH_ENTRY_BYTES = 48; // memory per hashtable entry of the search, including its bucket
+const int SERVER_HASH_MEGABYTES = 64; // hashtable per game in server mode
+const int DISTRIBUTE_CHUNK = 16; // jobs handed to a worker at once, see distribute.hpp
+const int DISTRIBUTE_COPIES = 2; // workers that may hold the same chunk, so a slow or lost one is covered
+const int DISTRIBUTE_CONNECT_SECONDS = 30; // how long a worker keeps trying to reach the coordinator
+const int TABLE_MEGABYTES = 256; // transposition table of the game window, see transposition.hpp
+const int DATABASE_GAMES_SHOWN = 20; // game numbers printed per query, see database.hpp
+
+// Proof-number search, see proof.hpp.
+const unsigned long PROOF_NODES = 20000; // positions per search of the game window, alongside alpha-beta
+const unsigned PROOF_TABLE_ENTRIES = 1 << 20;
+const unsigned PROOF_MAX_PLIES = 200;
+const unsigned PROOF_INFINITY = 1u << 30; // proof or disproof number of a decided position
+
+// Monte Carlo tree search, see mcts.hpp.
+const unsigned MCTS_DEFAULT_TIME = 5000; // milliseconds per turn without another budget
+const unsigned MCTS_POOL_NODES = 1 << 21;
+const int MCTS_CHILDREN = 64; // turns kept by nodes below the root
+const int MCTS_EXPAND_VISITS = 8; // visits before a leaf gets children
+const int MCTS_PLAYOUT_PLIES = 60;
+const double MCTS_ADJUDICATION = 1.0; // evaluation that counts as a win when a playout runs out
+const double MCTS_EXPLORATION = 1.4;
+
+// Neural network evaluation, see nnue.hpp. The layer sizes are part of the file format.
+const int NNUE_HIDDEN = 128; // first layer, updated incrementally
+const int NNUE_HIDDEN2 = 32;
+const int NNUE_HIDDEN3 = 32;
+const int NNUE_COUNT_FEATURES = 16; // inputs per reserve or capture count
+const int NNUE_SHIFT = 6; // scales the sums of the hidden layers back to 0..127
+const double NNUE_OUTPUT_SCALE = 1024.0; // network output per pawn
+
+// Evaluation tuning, see tune.hpp.
+const int TUNE_OPENING_PLIES = 8; // random plies before the engine plays itself
+const int TUNE_MAX_PLIES = 200; // games still running after this many plies are drawn
+const double TUNE_SCORE_LIMIT = 100.0; // positions with decided search scores are left out
+const double TUNE_RESULT_WEIGHT = 0.5; // share of the game result in the target, the rest is the search score
+const int TUNE_ITERATIONS = 1000;
+const double TUNE_LEARNING_RATE = 0.01;
+
 const double BBOX_SIZE = 0.9;
 
+// The evaluation values above, so engines can be configured (and tuned) at runtime.
+struct EvalParams {
+		double pawn = PAWN_VALUE;
+		double knight = KNIGHT_VALUE;
+		double pawn_reserve = PAWN_RESERVE_VALUE;
+		double knight_reserve = KNIGHT_RESERVE_VALUE;
+		double pawn_capture = PAWN_CAPTURE_VALUE;
+		double knight_capture = KNIGHT_CAPTURE_VALUE;
+		double center = CENTER_POSITION_VALUE;
+		double move = MOVE_VALUE;
+		double dispersion = EVAL_DISPERSION;
+};
+
 struct Rect {
 		double x, y;
 		double w, h;
@@ -82,6 +142,68 @@ struct Turn {
 #define TURN_REINFORCE 0x02
 #define TURN_REINFORCE_KNIGHT 0x04
 
+// Turns stored in files are packed into 64 bits: 4 bits per coordinate (16 bits per move),
+// followed by the move count and flags. Reinforcements only keep their target tile.
+typedef unsigned long long PackedTurn;
+
+inline PackedTurn PackTurn(const Turn& t) {
+	PackedTurn p = 0;
+	for (int i = 0; i < t.move_count and i < 3; i++) {
+		const Move& m = t.moves[i];
+		unsigned x1 = (t.flags & TURN_REINFORCE) ? 0 : m.x1;
+		unsigned y1 = (t.flags & TURN_REINFORCE) ? 0 : m.y1;
+		p |= (PackedTurn) ((x1 & 15) | (y1 & 15) << 4 | (m.x2 & 15) << 8 | (m.y2 & 15) << 12) << (16 * i);
+	}
+
+	p |= (PackedTurn) (t.move_count & 3) << 48;
+	p |= (PackedTurn) (t.flags & 7) << 50;
+	return p;
+}
+
+inline Turn UnpackTurn(PackedTurn p) {
+	Turn t;
+	t.move_count = (p >> 48) & 3;
+	t.flags = (p >> 50) & 7;
+
+	for (int i = 0; i < 3; i++) {
+		unsigned m = (p >> (16 * i)) & 0xFFFF;
+		t.moves[i] = { (int) (m & 15), (int) ((m >> 4) & 15), (int) ((m >> 8) & 15), (int) ((m >> 12) & 15) };
+		if (t.flags & TURN_REINFORCE) {
+			t.moves[i].x1 = -1;
+			t.moves[i].y1 = -1;
+		}
+	}
+
+	return t;
+}
+
+// Turns are equal if they make the same moves, in any order (the order depends on the piece list).
+inline bool SameTurn(const Turn& a, const Turn& b) {
+	if (a.move_count != b.move_count or a.flags != b.flags) return false;
+
+	PackedTurn pa = PackTurn(a), pb = PackTurn(b);
+	for (int i = 0; i < a.move_count; i++) {
+		bool found = false;
+		for (int j = 0; j < b.move_count and not found; j++) {
+			found = ((pa >> (16 * i)) & 0xFFFF) == ((pb >> (16 * j)) & 0xFFFF);
+		}
+
+		if (!found) return false;
+	}
+
+	return true;
+}
+
+// The turn on the mirror image of the board (see BasicPosition::mirror).
+inline Turn MirrorTurn(Turn t, int width) {
+	for (int i = 0; i < t.move_count and i < 3; i++) {
+		if (t.moves[i].x1 >= 0) t.moves[i].x1 = width - 1 - t.moves[i].x1;
+		t.moves[i].x2 = width - 1 - t.moves[i].x2;
+	}
+
+	return t;
+}
+
 #define WINSTATE_NONE 0x00
 #define WINSTATE_DRAW 0x01
 #define WINSTATE_WHITE 0x02
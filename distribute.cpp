@@ -0,0 +1,539 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "distribute.hpp"
+#include "engine.hpp"
+#include "record.hpp"
+
+// One end of a connection between the coordinator and a worker. Each end is only used by one
+// thread, the coordinator just shuts it down from outside to cut a worker off.
+struct Channel {
+		int fd;
+		std::string buffer;
+
+		explicit Channel(int fd) {
+			this->fd = fd;
+		}
+
+		~Channel() {
+			close(fd);
+		}
+
+		bool Send(const std::string& line) {
+			std::string s = line + '\n';
+
+			for (std::size_t done = 0; done < s.size();) {
+				ssize_t n = write(fd, s.data() + done, s.size() - done);
+				if (n <= 0) return false;
+				done += n;
+			}
+
+			return true;
+		}
+
+		bool Receive(std::string& line) {
+			std::size_t end;
+			while ((end = buffer.find('\n')) == std::string::npos) {
+				char buf[4096];
+				ssize_t n = read(fd, buf, sizeof(buf));
+				if (n <= 0) return false;
+				buffer.append(buf, n);
+			}
+
+			line = buffer.substr(0, end);
+			buffer.erase(0, end + 1);
+			if (!line.empty() and line.back() == '\r') line.pop_back();
+			return true;
+		}
+};
+
+static std::vector<std::string> SplitFields(const std::string& line) {
+	std::vector<std::string> fields;
+	std::size_t start = 0, end;
+
+	while ((end = line.find('\t', start)) != std::string::npos) {
+		fields.push_back(line.substr(start, end - start));
+		start = end + 1;
+	}
+
+	fields.push_back(line.substr(start));
+	return fields;
+}
+
+// A position of the input, or a slice of its root turns.
+struct Job {
+		unsigned long task, chunk;
+		int first, count; // root turns
+		bool done;
+
+		int turn; // index into possibleTurns(), -1 for none
+		double score;
+		int depth;
+		unsigned long nodes;
+		unsigned ms;
+};
+
+// A line of the input, written once all of its jobs are done.
+struct Task {
+		std::string summary;
+		std::vector<unsigned long> jobs;
+		unsigned long remaining;
+		std::string line;
+};
+
+struct Chunk {
+		std::vector<unsigned long> jobs;
+		unsigned long remaining;
+		int holders; // workers searching it right now
+		unsigned long issued; // when it was last handed out
+};
+
+struct CoordinatorState {
+		std::mutex lock;
+		std::condition_variable changed;
+		std::vector<Task> tasks;
+		std::vector<Job> jobs;
+		std::vector<Chunk> chunks;
+		std::deque<unsigned long> pending; // chunks nobody holds, lost ones first
+		unsigned long written, sequence;
+		int depth;
+		std::FILE* out;
+		int listener;
+
+		inline bool finished() const {
+			return written == tasks.size();
+		}
+};
+
+// The chunk to hand out next, or -1 if every chunk that is left has all the holders it may have.
+// The caller holds the lock.
+static long NextChunk(CoordinatorState& state) {
+	while (!state.pending.empty()) {
+		unsigned long c = state.pending.front();
+		state.pending.pop_front();
+
+		// Lost chunks may also have been finished or handed out again in the meantime.
+		if (state.chunks[c].remaining > 0 and state.chunks[c].holders == 0) return c;
+	}
+
+	// A copy of the chunk that has been out the longest.
+	long best = -1;
+	for (unsigned long c = 0; c < state.chunks.size(); c++) {
+		const Chunk& chunk = state.chunks[c];
+		if (chunk.remaining == 0 or chunk.holders >= DISTRIBUTE_COPIES) continue;
+		if (best < 0 or chunk.issued < state.chunks[best].issued) best = c;
+	}
+
+	return best;
+}
+
+static void ReleaseChunk(CoordinatorState& state, long c) {
+	if (c < 0) return;
+
+	Chunk& chunk = state.chunks[c];
+	chunk.holders--;
+	if (chunk.holders == 0 and chunk.remaining > 0) state.pending.push_front(c);
+	state.changed.notify_all();
+}
+
+// Puts the slices of a task together into its line of output: the best turn for the side to move,
+// searched to the depth of the shallowest slice. The caller holds the lock.
+static void FinishTask(CoordinatorState& state, Task& task) {
+	Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+	board.LoadPosition(task.summary);
+	std::vector<Turn> turns = board.possibleTurns();
+	bool white = board.getPosition().turn;
+
+	const Job* best = nullptr;
+	int depth = 0;
+	unsigned long nodes = 0;
+	unsigned ms = 0;
+
+	for (unsigned long j : task.jobs) {
+		const Job& job = state.jobs[j];
+		if (j == task.jobs.front() or job.depth < depth) depth = job.depth;
+		nodes += job.nodes;
+		ms += job.ms;
+
+		if (job.turn >= 0 and job.turn < (int) turns.size() and (best == nullptr or (white ? job.score > best->score : job.score < best->score))) best = &job;
+	}
+
+	char buf[128];
+	std::snprintf(buf, sizeof(buf), "\t%.3f\t%d\t%lu\t%u\n", best != nullptr ? best->score : 0.0, depth, nodes, ms);
+	task.line = task.summary + '\t' + (best != nullptr ? TurnString(turns[best->turn]) : "none") + buf;
+}
+
+// Writes all lines that are next in line, and stops taking workers once the last one is written.
+// The caller holds the lock.
+static void FlushTasks(CoordinatorState& state) {
+	while (!state.finished() and !state.tasks[state.written].line.empty()) {
+		std::fputs(state.tasks[state.written].line.c_str(), state.out);
+		std::string().swap(state.tasks[state.written].line);
+		state.written++;
+	}
+
+	std::fflush(state.out);
+
+	if (state.finished()) {
+		if (state.listener >= 0) shutdown(state.listener, SHUT_RDWR);
+		state.changed.notify_all();
+	}
+}
+
+static void RecordResult(CoordinatorState& state, const std::vector<std::string>& fields) {
+	if (fields.size() < 7) return;
+
+	unsigned long id = std::strtoul(fields[1].c_str(), nullptr, 10);
+	if (id >= state.jobs.size()) return;
+
+	// The first copy of a job to finish counts.
+	Job& job = state.jobs[id];
+	if (job.done) return;
+
+	job.done = true;
+	job.turn = std::atoi(fields[2].c_str());
+	job.score = std::atof(fields[3].c_str());
+	job.depth = std::atoi(fields[4].c_str());
+	job.nodes = std::strtoul(fields[5].c_str(), nullptr, 10);
+	job.ms = (unsigned) std::strtoul(fields[6].c_str(), nullptr, 10);
+
+	state.chunks[job.chunk].remaining--;
+	Task& task = state.tasks[job.task];
+	if (--task.remaining == 0) {
+		FinishTask(state, task);
+		FlushTasks(state);
+	}
+}
+
+static void ServeWorker(CoordinatorState& state, std::shared_ptr<Channel> channel) {
+	long held = -1;
+	std::string line;
+
+	while (channel->Receive(line)) {
+		std::vector<std::string> fields = SplitFields(line);
+
+		if (fields[0] == "result") {
+			std::lock_guard<std::mutex> guard(state.lock);
+			RecordResult(state, fields);
+		} else if (fields[0] == "ready") {
+			std::string message;
+			{
+				std::unique_lock<std::mutex> guard(state.lock);
+				ReleaseChunk(state, held);
+				held = -1;
+
+				while (!state.finished() and (held = NextChunk(state)) < 0) {
+					state.changed.wait(guard);
+				}
+
+				if (held < 0) break;
+
+				Chunk& chunk = state.chunks[held];
+				chunk.holders++;
+				chunk.issued = state.sequence++;
+
+				unsigned long count = 0;
+				for (unsigned long j : chunk.jobs) {
+					const Job& job = state.jobs[j];
+					if (job.done) continue;
+
+					message += std::to_string(j) + '\t' + std::to_string(state.depth) + '\t' + state.tasks[job.task].summary + '\t' + std::to_string(job.first) + '\t' + std::to_string(job.count) + '\n';
+					count++;
+				}
+
+				message = "job\t" + std::to_string(count) + '\n' + message;
+				message.pop_back();
+			}
+
+			if (!channel->Send(message)) break;
+		}
+	}
+
+	bool finished;
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		finished = state.finished();
+		ReleaseChunk(state, held);
+	}
+
+	if (finished) channel->Send("done");
+}
+
+bool RunCoordinator(std::string input, std::string output, int port, int depth, int chunk, int slices) {
+	if (chunk <= 0) chunk = 1;
+	if (slices <= 0) slices = 1;
+
+	std::FILE* in = (input == "-" ? stdin : std::fopen(input.c_str(), "r"));
+	if (in == nullptr) {
+		printf("Failed to open %s.\n", input.c_str());
+		return false;
+	}
+
+	CoordinatorState state;
+	state.written = 0;
+	state.sequence = 0;
+	state.depth = depth;
+	state.listener = -1;
+
+	// Every position is read up front, checked and cut into slices, so nothing but results is left
+	// to wait for once the workers are running.
+	std::vector<std::vector<std::pair<int, int>>> cuts;
+	unsigned long failed = 0;
+	char buf[1024];
+
+	while (std::fgets(buf, sizeof(buf), in) != nullptr) {
+		std::string l(buf);
+		while (!l.empty() and (l.back() == '\n' or l.back() == '\r')) {
+			l.pop_back();
+		}
+
+		if (l.empty()) continue;
+
+		Task task;
+		task.summary = l;
+		task.remaining = 0;
+		std::vector<std::pair<int, int>> cut;
+
+		Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+		if (!board.LoadPosition(l)) {
+			task.line = l + "\terror\n";
+			failed++;
+		} else {
+			int n = (int) board.possibleTurns().size();
+			int s = std::min(slices, n);
+
+			for (int k = 0; k < s; k++) {
+				cut.push_back(std::make_pair(k * n / s, (k + 1) * n / s - k * n / s));
+			}
+
+			if (n == 0) task.line = l + "\tnone\t0.000\t0\t0\t0\n";
+		}
+
+		state.tasks.push_back(task);
+		cuts.push_back(cut);
+	}
+
+	if (in != stdin) std::fclose(in);
+
+	// A chunk holds the same slice of up to `chunk` positions, so the slices of a position go to
+	// different workers.
+	for (unsigned long t = 0; t < state.tasks.size(); t += chunk) {
+		unsigned long end = std::min<unsigned long>(t + chunk, state.tasks.size());
+
+		for (int k = 0; k < slices; k++) {
+			Chunk c;
+			c.holders = 0;
+			c.issued = 0;
+
+			for (unsigned long i = t; i < end; i++) {
+				if (k >= (int) cuts[i].size()) continue;
+
+				Job job = { };
+				job.task = i;
+				job.chunk = state.chunks.size();
+				job.first = cuts[i][k].first;
+				job.count = cuts[i][k].second;
+				job.turn = -1;
+
+				c.jobs.push_back(state.jobs.size());
+				state.tasks[i].jobs.push_back(state.jobs.size());
+				state.tasks[i].remaining++;
+				state.jobs.push_back(job);
+			}
+
+			c.remaining = c.jobs.size();
+			if (c.remaining == 0) continue;
+
+			state.pending.push_back(state.chunks.size());
+			state.chunks.push_back(c);
+		}
+	}
+
+	state.out = (output == "-" ? stdout : std::fopen(output.c_str(), "w"));
+	if (state.out == nullptr) {
+		printf("Failed to open %s for writing.\n", output.c_str());
+		return false;
+	}
+
+	FlushTasks(state);
+
+	if (!state.finished()) {
+		sockaddr_in addr = { };
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(port);
+
+		int reuse = 1;
+		state.listener = socket(AF_INET, SOCK_STREAM, 0);
+		if (state.listener >= 0) setsockopt(state.listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		if (state.listener < 0 or bind(state.listener, (sockaddr*) &addr, sizeof(addr)) != 0 or listen(state.listener, 64) != 0) {
+			printf("Failed to listen on port %d.\n", port);
+			if (state.listener >= 0) close(state.listener);
+			if (state.out != stdout) std::fclose(state.out);
+			return false;
+		}
+
+		// Results go to standard output unless there is an output file.
+		if (state.out != stdout) printf("Listening on port %d with %lu positions in %lu chunks.\n", port, state.tasks.size(), state.chunks.size());
+	}
+
+	// A worker that went away should not take the coordinator with it.
+	std::signal(SIGPIPE, SIG_IGN);
+
+	unsigned start = SDL_GetTicks();
+	std::vector<std::thread> workers;
+	std::vector<std::shared_ptr<Channel>> channels;
+
+	int fd;
+	while (state.listener >= 0 and (fd = accept(state.listener, nullptr, nullptr)) >= 0) {
+		// Messages are short and answered right away, and dead machines should be noticed.
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+
+		std::shared_ptr<Channel> channel = std::make_shared<Channel>(fd);
+		channels.push_back(channel);
+		workers.push_back(std::thread(ServeWorker, std::ref(state), channel));
+	}
+
+	// Workers still searching copies of finished chunks are cut off.
+	for (const std::shared_ptr<Channel>& c : channels) {
+		shutdown(c->fd, SHUT_RDWR);
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	if (state.listener >= 0) close(state.listener);
+	if (state.out != stdout) {
+		std::fclose(state.out);
+		printf("Analysed %lu positions with %lu workers in %.1f s.\n", state.tasks.size(), channels.size(), 0.001 * (SDL_GetTicks() - start));
+		if (failed > 0) printf("%lu of %lu positions could not be read.\n", failed, state.tasks.size());
+	}
+
+	return failed == 0;
+}
+
+static int ConnectTo(const std::string& host, int port) {
+	addrinfo hints = { };
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo* list = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &list) != 0) return -1;
+
+	int fd = -1;
+	for (addrinfo* a = list; a != nullptr and fd < 0; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd >= 0 and connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	freeaddrinfo(list);
+	return fd;
+}
+
+static void WorkerThread(std::string host, int port, std::atomic<int>& connected, std::atomic<unsigned long>& searched) {
+	int fd = ConnectTo(host, port);
+	for (int i = 0; i < DISTRIBUTE_CONNECT_SECONDS and fd < 0; i++) {
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		fd = ConnectTo(host, port);
+	}
+
+	if (fd < 0) return;
+	connected++;
+
+	int on = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+	Channel channel(fd);
+	Engine engine;
+	engine.useBook = false;
+	std::string line;
+
+	while (channel.Send("ready") and channel.Receive(line)) {
+		std::vector<std::string> fields = SplitFields(line);
+		if (fields[0] != "job" or fields.size() < 2) return;
+
+		unsigned long count = std::strtoul(fields[1].c_str(), nullptr, 10);
+		for (unsigned long i = 0; i < count; i++) {
+			if (!channel.Receive(line)) return;
+
+			fields = SplitFields(line);
+			if (fields.size() < 5) return;
+
+			SearchResult r = { };
+			int turn = -1;
+			unsigned ms = 0;
+
+			Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+			if (board.LoadPosition(fields[2])) {
+				std::vector<Turn> turns = board.possibleTurns();
+				int first = std::max(0, std::min(std::atoi(fields[3].c_str()), (int) turns.size()));
+				int n = std::max(0, std::min(std::atoi(fields[4].c_str()), (int) turns.size() - first));
+				engine.searchTurns.assign(turns.begin() + first, turns.begin() + first + n);
+
+				unsigned start = SDL_GetTicks();
+				r = engine.Search(&board, std::atoi(fields[1].c_str()));
+				ms = SDL_GetTicks() - start;
+
+				for (unsigned k = 0; k < turns.size() and r.found; k++) {
+					if (SameTurn(turns[k], r.turn)) {
+						turn = k;
+						break;
+					}
+				}
+			}
+
+			char buf[128];
+			std::snprintf(buf, sizeof(buf), "\t%d\t%.6f\t%d\t%lu\t%u", turn, r.score, r.depth, r.nodes, ms);
+			if (!channel.Send("result\t" + fields[0] + buf)) return;
+			searched++;
+		}
+	}
+}
+
+bool RunWorker(std::string host, int port, int threads) {
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// A coordinator that went away is the end of the work, not of the process.
+	std::signal(SIGPIPE, SIG_IGN);
+
+	std::atomic<int> connected(0);
+	std::atomic<unsigned long> searched(0);
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.push_back(std::thread(WorkerThread, host, port, std::ref(connected), std::ref(searched)));
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	if (connected == 0) {
+		printf("Failed to connect to %s:%d.\n", host.c_str(), port);
+		return false;
+	}
+
+	printf("Searched %lu jobs on %d threads.\n", searched.load(), connected.load());
+	return true;
+}
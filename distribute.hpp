@@ -0,0 +1,35 @@
+#ifndef DISTRIBUTE_HPP
+#define DISTRIBUTE_HPP
+
+#include <string>
+
+// A batch analysis spread over worker processes on any number of machines. The coordinator reads
+// positions like AnalyseBatch, hands them out to the workers that connect to it over TCP on `port`
+// and writes their results to output in input order, in the same format as AnalyseBatch. With
+// `slices` above 1, the root turns of each position are split into that many slices, which are
+// searched by different workers, and the best turn of all slices is written, with the nodes and
+// milliseconds of all of them.
+//
+// Jobs are handed out in chunks of `chunk` positions or slices. Every result is kept as soon as a
+// worker sends it, and the rest of the chunk of a worker that goes away is handed to the next
+// worker that asks. Once nothing is left to hand out, workers that ask get a copy of a chunk that
+// is still being searched elsewhere (up to DISTRIBUTE_COPIES workers per chunk), so a slow or
+// unreachable worker cannot hold up the end of the run; whichever copy finishes first counts.
+//
+// The protocol is one line per message, with tab-separated fields:
+//   worker:      ready                                         asks for a chunk
+//   coordinator: job <count>, then <count> lines of
+//                <id> <depth> <summary> <first> <count>        turns [first, first + count) of
+//                                                              the position's possibleTurns()
+//   coordinator: done                                          nothing left, the worker stops
+//   worker:      result <id> <turn> <score> <depth> <nodes> <ms>
+//                                                              after each job; turn is an index
+//                                                              into possibleTurns(), -1 for none
+bool RunCoordinator(std::string input, std::string output, int port, int depth, int chunk, int slices);
+
+// Connects `threads` workers (all cores if 0), each with an engine of its own, to the coordinator
+// at host:port and searches what it hands out until it is done or goes away. Workers may be
+// started before the coordinator, they keep trying to connect for DISTRIBUTE_CONNECT_SECONDS.
+bool RunWorker(std::string host, int port, int threads);
+
+#endif // DISTRIBUTE_HPP
@@ -0,0 +1,739 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "book.hpp"
+#include "engine.hpp"
+#include "evalcache.hpp"
+#include "mcts.hpp"
+#include "nnue.hpp"
+#include "profile.hpp"
+#include "proof.hpp"
+#include "rules.hpp"
+#include "tablebase.hpp"
+#include "transposition.hpp"
+
+Engine::Engine() : gen(std::random_device()()), noise(0.0, 1.0), solved(false) {
+	this->verbose = false;
+	this->useBook = true;
+	this->maxNodes = 0;
+	this->maxTime = 0;
+	this->beam = 0;
+	this->subPlies = false;
+	this->rootTurns = nullptr;
+	this->mcts = 0;
+	this->maxHashEntries = 0;
+	this->proofNodes = 0;
+	this->evalCache = std::make_shared<EvalCache>(EVAL_CACHE_ENTRIES);
+	this->evalKey = 0;
+	this->nodes = 0;
+	this->started = 0;
+	this->stopped = false;
+}
+
+Engine::~Engine() {
+}
+
+bool Engine::Stop() {
+	if (stopped) return true;
+
+	if (solved.load(std::memory_order_relaxed)) stopped = true;
+	if (maxNodes > 0 and nodes >= maxNodes) stopped = true;
+	if (maxTime > 0 and (nodes & 63) == 0 and SDL_GetTicks() - started >= maxTime) stopped = true;
+
+	return stopped;
+}
+
+// Without a transposition table, a position searched once in this search is taken as it was, to
+// any depth and within any bounds. The table keeps the depth and the kind of bound with the score,
+// and outlives the search, so its keys tell the evaluations apart like those of evalCache.
+bool Engine::ProbeTable(std::uint64_t key, int depth, double alpha, double beta, double& score) {
+	key ^= evalKey;
+
+	if (!table) {
+		auto it = hashtable.find(key);
+		if (it == hashtable.end()) return false;
+
+		score = it->second;
+		return true;
+	}
+
+	TableValue v;
+	if (!table->Probe(key, v) or v.depth < depth) return false;
+	if (v.bound == BOUND_LOWER and v.score < beta) return false;
+	if (v.bound == BOUND_UPPER and v.score > alpha) return false;
+
+	score = v.score;
+	return true;
+}
+
+void Engine::StoreTable(std::uint64_t key, int depth, double alpha, double beta, double score) {
+	key ^= evalKey;
+
+	if (!table) {
+		if (maxHashEntries == 0 or hashtable.size() < maxHashEntries) hashtable[key] = score;
+		return;
+	}
+
+	TableValue v;
+	v.score = (float) score;
+	v.depth = depth;
+	v.bound = (score <= alpha ? BOUND_UPPER : (score >= beta ? BOUND_LOWER : BOUND_EXACT));
+	table->Store(key, v);
+}
+
+static double StateScore(int state) {
+	switch (state) {
+		case WINSTATE_WHITE:
+			return +1000.0;
+		case WINSTATE_BLACK:
+			return -1000.0;
+		default:
+			return 0.0;
+	}
+}
+
+// Evaluations are cached under the position's hash and a key of the evaluation that made them. The
+// cache keeps floats, so every evaluation is rounded to one, and the search comes out the same
+// whether or not an evaluation was cached.
+template <int N>
+double Engine::Static(const PositionRules<N>& rules, const BasicPosition<N>& position, const Accumulator* acc, const StepTable<N>* steps) {
+	const std::uint64_t key = position.hash() ^ evalKey;
+	double score;
+	if (evalCache and evalCache->Probe(key, score)) return score;
+
+	if (acc) score = network->Evaluate(*acc);
+	else score = (steps ? rules.Evaluate(position, *steps, params) : rules.Evaluate(position, params));
+	score = (float) score;
+	if (evalCache) evalCache->Store(key, score);
+	return score;
+}
+
+// The network, or else every evaluation value; the noise does not change evaluations. Keys are the
+// same in every process, as the transposition table may be kept in a file.
+static std::uint64_t EvalKey(const EvalParams& params, const Network* network) {
+	if (network != nullptr) return MixHash(network->fingerprint());
+
+	const double values[] = { params.pawn, params.knight, params.pawn_reserve, params.knight_reserve, params.pawn_capture, params.knight_capture, params.center, params.move };
+	std::uint64_t h = 0;
+	for (double v : values) {
+		std::uint64_t bits;
+		std::memcpy(&bits, &v, sizeof(bits));
+		h = MixHash(h ^ bits);
+	}
+
+	return h;
+}
+
+template <int N>
+double Engine::AlphaBetaPrune(const PositionRules<N>& rules, const BasicPosition<N>& position, const Accumulator* acc, const StepTable<N>* steps, int depth, double alpha, double beta) {
+	nodes++;
+
+	if (Stop()) return 0.0;
+
+	double score;
+	if (tablebase.Score(position, score)) return score;
+
+	int state = (steps ? rules.WinState(position, *steps) : rules.WinState(position));
+	if (state != WINSTATE_NONE) return StateScore(state);
+
+	if (depth == 0) return Static(rules, position, acc, steps);
+
+	// Only leaves go without steps.
+	const StepTable<N>& table = *steps;
+
+	if (subPlies) {
+		std::vector<Turn> singles;
+		rules.singleTurns(position, singles);
+		if (singles.size() == 0) return Static(rules, position, acc, steps);
+
+		Turn turn = { };
+		turn.flags = TURN_MOVE;
+		return SubPlyPrune(rules, position, acc, table, singles, 0, position.hash(), turn, depth, alpha, beta, nullptr);
+	}
+
+	std::vector<Turn> turns;
+	rules.possibleTurns(position, table, turns, (beam > 0 ? beam + depth - 1 : 0));
+
+	if (turns.size() == 0) return Static(rules, position, acc, steps);
+	if (depth == 1 and acc == nullptr) return FrontierPrune(rules, position, table, turns, alpha, beta);
+
+	double val, wal;
+
+	if (position.turn) {
+		val = -1000.0;
+
+		for (unsigned j = 0; j < turns.size(); j++) {
+			BasicPosition<N> child = position;
+			rules.PlayTurn(child, turns[j]);
+			wal = SearchChild(rules, position, acc, table, child, depth - 1, alpha, beta);
+
+			if (stopped) return 0.0;
+			if (wal > val) val = wal;
+			if (val > alpha) alpha = val;
+			if (alpha >= beta) break;
+		}
+	} else {
+		val = +1000.0;
+
+		for (unsigned j = 0; j < turns.size(); j++) {
+			BasicPosition<N> child = position;
+			rules.PlayTurn(child, turns[j]);
+			wal = SearchChild(rules, position, acc, table, child, depth - 1, alpha, beta);
+
+			if (stopped) return 0.0;
+			if (wal < val) val = wal;
+			if (val < beta) beta = val;
+			if (alpha >= beta) break;
+		}
+	}
+
+	return val;
+}
+
+// The last ply before the leaves. The first child is searched as usual, which is often enough for a
+// cutoff. After that, children that are repeated, in the hashtable, in the tablebases or in
+// evalCache are taken from there, and the rest are scored a batch at a time by EvaluateChildren()
+// instead of one by one, and go into evalCache like the evaluations of Static(). Batches start
+// small and grow, so a cutoff early on still saves most of the work.
+template <int N>
+double Engine::FrontierPrune(const PositionRules<N>& rules, const BasicPosition<N>& position, const StepTable<N>& steps, const std::vector<Turn>& turns, double alpha, double beta) {
+	const bool side = position.turn;
+
+	BasicPosition<N> first = position;
+	rules.PlayTurn(first, turns[0]);
+	double val = SearchChild(rules, position, nullptr, steps, first, 0, alpha, beta);
+
+	// Takes in the score of a child, and tells if the rest can be cut.
+	auto visit = [&](double wal) {
+		if (side ? wal > val : wal < val) val = wal;
+		if (side and val > alpha) alpha = val;
+		if (!side and val < beta) beta = val;
+		return alpha >= beta;
+	};
+
+	if (stopped or visit(val)) return val;
+
+	std::vector<BasicPosition<N>> batch;
+	std::vector<std::uint64_t> keys, hashes;
+	double scores[FRONTIER_BATCH_MAX];
+	unsigned size = FRONTIER_BATCH;
+
+	// Scores the batch, and tells if the rest can be cut.
+	auto evaluate = [&]() {
+		const int count = batch.size();
+		nodes += count;
+
+		// A batch is reason enough to look at the clock.
+		if (maxTime > 0 and SDL_GetTicks() - started >= maxTime) stopped = true;
+		if (Stop()) return true;
+
+		rules.EvaluateChildren(position, steps, batch.data(), count, params, scores);
+
+		bool cut = false;
+		for (int i = 0; i < count; i++) {
+			// Rounded like in Static(). The leaves' scores are exact, whatever the window.
+			scores[i] = (float) scores[i];
+			if (evalCache) evalCache->Store(hashes[i] ^ evalKey, scores[i]);
+			StoreTable(keys[i], 0, -1000.0, +1000.0, scores[i]);
+			cut = cut or visit(scores[i]);
+		}
+
+		batch.clear();
+		keys.clear();
+		hashes.clear();
+		size = std::min(2 * size, FRONTIER_BATCH_MAX);
+		return cut;
+	};
+
+	for (unsigned j = 1; j < turns.size(); j++) {
+		BasicPosition<N> child = position;
+		rules.PlayTurn(child, turns[j]);
+
+		std::uint64_t hash = child.hash(), mirrored = child.mirror().hash();
+		std::uint64_t key = (mirrored < hash ? mirrored : hash);
+
+		double wal = 0.0;
+		bool known = std::count(path.begin(), path.end(), hash) >= 2;
+		if (!known) known = ProbeTable(key, 0, alpha, beta, wal);
+		if (!known and tablebase.Score(child, wal)) known = true;
+		if (!known and evalCache and evalCache->Probe(hash ^ evalKey, wal)) {
+			nodes++;
+			known = true;
+		}
+
+		if (known) {
+			if (visit(wal)) return val;
+			continue;
+		}
+
+		batch.push_back(child);
+		keys.push_back(key);
+		hashes.push_back(hash);
+		if (batch.size() == size and evaluate()) return (stopped ? 0.0 : val);
+	}
+
+	if (!batch.empty()) evaluate();
+	return (stopped ? 0.0 : val);
+}
+
+// Looks a child up in the hashtable, or searches it. A position that already occurred twice in the
+// game or in the line leading up to it is a draw by repetition. That depends on the game rather
+// than the position, so it comes before the hashtable and is not stored there, where it would
+// outlive the search. Mirror images share their entry. Steps are those of the parent.
+template <int N>
+double Engine::SearchChild(const PositionRules<N>& rules, const BasicPosition<N>& parent, const Accumulator* acc, const StepTable<N>& steps, const BasicPosition<N>& child, int depth, double alpha, double beta) {
+	std::uint64_t hash = child.hash(), mirrored = child.mirror().hash();
+	std::uint64_t key = (mirrored < hash ? mirrored : hash);
+
+	if (std::count(path.begin(), path.end(), hash) >= 2) return 0.0;
+
+	double wal;
+	if (ProbeTable(key, depth, alpha, beta, wal)) return wal;
+
+	// The network's first layer follows the child from its parent, and only once it is searched.
+	// So do the legal steps, unless the child is a leaf, which is mostly in evalCache.
+	Accumulator childAcc;
+	if (acc) network->Update(parent, *acc, child, childAcc);
+
+	StepTable<N> childSteps;
+	if (depth > 0) rules.UpdateSteps(parent, steps, child, childSteps);
+
+	path.push_back(hash);
+	wal = AlphaBetaPrune(rules, child, (acc ? &childAcc : nullptr), (depth > 0 ? &childSteps : nullptr), depth, alpha, beta);
+	path.pop_back();
+
+	if (!stopped) StoreTable(key, depth, alpha, beta, wal);
+	return wal;
+}
+
+// One ply of a turn that is built a move at a time: the moves so far are in turn, and every one
+// of them is legal on the position before the turn. The turn may end here, or go on with a move of
+// a piece after the last one that moved (from `from` on in singles, so every set of moves is only
+// built in one order) to a tile no other move went to. A capture or a reinforcement is a turn of
+// its own. Choosing a move costs one ply of depth, ending the turn costs nothing, and without any
+// depth left the turn has to end, after which the other side's evaluation is taken.
+//
+// The hashtable keeps these plies under the position before the turn and the moves so far. At the
+// root, the best turn and its score are written to root as soon as they are found.
+template <int N>
+double Engine::SubPlyPrune(const PositionRules<N>& rules, const BasicPosition<N>& position, const Accumulator* acc, const StepTable<N>& steps, const std::vector<Turn>& singles, unsigned from, std::uint64_t hash, Turn& turn, int depth, double alpha, double beta, SearchResult* root) {
+	const int count = turn.move_count;
+	const bool side = position.turn;
+	const double lower = alpha, upper = beta;
+
+	if (count > 0) {
+		nodes++;
+		if (Stop()) return 0.0;
+
+		double score;
+		if (root == nullptr and ProbeTable(hash, depth, alpha, beta, score)) return score;
+	}
+
+	double val = (side ? -1000.0 : +1000.0);
+
+	// Takes in the score of a finished turn or a longer one, and tells if the rest can be cut. At the
+	// root, finished turns come with the noise n on their score, like in SearchRoot.
+	auto visit = [&](double wal, const Turn* finished, double n) {
+		if (stopped) return true;
+
+		if (finished != nullptr and root != nullptr) {
+			rootScores.push_back(std::make_pair(*finished, wal - n));
+			if (!root->found or (side ? wal > alpha : wal < beta)) {
+				root->turn = *finished;
+				root->score = wal - n;
+				root->found = true;
+			}
+		}
+
+		if (side ? wal > val : wal < val) val = wal;
+		if (side and val > alpha) alpha = val;
+		if (!side and val < beta) beta = val;
+		return alpha >= beta;
+	};
+
+	auto finish = [&](const Turn& t, int d) {
+		if (root != nullptr and rootTurns != nullptr and std::none_of(rootTurns->begin(), rootTurns->end(), [&t](const Turn& u) {
+			return SameTurn(t, u);
+		})) return false;
+
+		BasicPosition<N> child = position;
+		rules.PlayTurn(child, t);
+		const double n = (root != nullptr ? params.dispersion * noise(gen) : 0.0);
+		return visit(SearchChild(rules, position, acc, steps, child, d, alpha - n, beta - n) + n, &t, n);
+	};
+
+	bool cut = false;
+
+	if (count > 0) cut = finish(turn, depth);
+
+	for (unsigned a = from; a < singles.size() and depth > 0 and not cut; a++) {
+		const Turn& s = singles[a];
+		const Move& m = s.moves[0];
+
+		if ((s.flags & TURN_REINFORCE) or position.occupied(position.tile(m.x2, m.y2))) {
+			if (count > 0) continue;
+
+			cut = finish(s, depth - 1);
+			continue;
+		}
+
+		bool taken = false;
+		for (int i = 0; i < count; i++) {
+			taken = taken or (turn.moves[i].x2 == m.x2 and turn.moves[i].y2 == m.y2);
+		}
+		if (taken) continue;
+
+		// The moves of a piece are next to each other, the pieces after it follow.
+		unsigned next = a + 1;
+		while (next < singles.size() and singles[next].moves[0].x1 == m.x1 and singles[next].moves[0].y1 == m.y1) {
+			next++;
+		}
+
+		turn.moves[count] = m;
+		turn.move_count = count + 1;
+
+		if (count + 1 == 3) {
+			Turn finished = turn;
+			turn.move_count = count;
+			cut = finish(finished, depth - 1);
+		} else {
+			std::uint64_t h = MixHash(hash ^ ((std::uint64_t) (m.x1 | m.y1 << 8 | m.x2 << 16 | m.y2 << 24) << 8 | (count + 1)));
+			double wal = SubPlyPrune(rules, position, acc, steps, singles, next, h, turn, depth - 1, alpha, beta, root);
+			turn.move_count = count;
+			cut = visit(wal, nullptr, 0.0);
+		}
+	}
+
+	if (count > 0 and root == nullptr and !stopped) StoreTable(hash, depth, lower, upper, val);
+	return val;
+}
+
+// Searches every root turn to the given depth. Returns false if the budget ran out first, in which
+// case result holds the best of the root turns that were completed, if any.
+//
+// Each root turn's score gets noise of EVAL_DISPERSION, so the engine varies between turns that are
+// (nearly) as good. Its search window is shifted by the same amount, which keeps the pruning exact
+// for the scores with noise, while the scores below the root stay as they are and can be cached.
+template <int N>
+bool Engine::SearchRoot(const PositionRules<N>& rules, const BasicPosition<N>& position, std::vector<Turn>& turns, int depth, SearchResult& result) {
+	double val, wal, score = 0.0;
+	unsigned bt = 0;
+
+	double alpha = -1000.0;
+	double beta = +1000.0;
+	const unsigned k = (unsigned) 100;
+
+	hashtable.clear();
+	rootScores.clear();
+
+	Accumulator rootAcc;
+	const Accumulator* acc = nullptr;
+	if (network) {
+		network->Refresh(position, rootAcc);
+		acc = &rootAcc;
+	}
+
+	StepTable<N> steps;
+	rules.legalSteps(position, steps);
+
+	if (subPlies) {
+		std::vector<Turn> singles;
+		rules.singleTurns(position, singles);
+
+		// Only the moves of the root turns, and only those turns are finished at the root, so a slice
+		// of them (see searchTurns) is searched as such.
+		singles.erase(std::remove_if(singles.begin(), singles.end(), [&turns](const Turn& s) {
+			return std::none_of(turns.begin(), turns.end(), [&s](const Turn& t) {
+				if (s.flags != TURN_MOVE or t.flags != TURN_MOVE) return SameTurn(s, t);
+
+				const Move& m = s.moves[0];
+				for (int i = 0; i < t.move_count; i++) {
+					const Move& u = t.moves[i];
+					if (u.x1 == m.x1 and u.y1 == m.y1 and u.x2 == m.x2 and u.y2 == m.y2) return true;
+				}
+				return false;
+			});
+		}), singles.end());
+		rootTurns = (searchTurns.empty() ? nullptr : &turns);
+
+		SearchResult r = result;
+		r.found = false;
+		Turn turn = { };
+		turn.flags = TURN_MOVE;
+		SubPlyPrune(rules, position, acc, steps, singles, 0, position.hash(), turn, depth, alpha, beta, &r);
+
+		if (r.found) {
+			result.turn = r.turn;
+			result.score = r.score;
+			result.depth = depth;
+			result.found = true;
+		}
+
+		return !stopped;
+	}
+
+	if (position.turn) {
+		val = -1000.0;
+
+		for (unsigned j = 0; j < turns.size(); j++) {
+			BasicPosition<N> child = position;
+			rules.PlayTurn(child, turns[j]);
+			const double n = params.dispersion * noise(gen);
+			wal = SearchChild(rules, position, acc, steps, child, depth - 1, alpha - n, beta - n) + n;
+
+			if (stopped) break;
+			rootScores.push_back(std::make_pair(turns[j], wal - n));
+
+			if (verbose and j > 0 and j % k == 0) printf("[%u/%lu] %.1f s (%lu hashes)\n", j, turns.size(), ((0.001 * (turns.size() - j) / turns.size()) * (SDL_GetTicks() - started)), hashtable.size());
+
+			if (wal > val) {
+				val = wal;
+				score = wal - n;
+				bt = j;
+			}
+			if (val > alpha) alpha = val;
+			if (alpha >= beta) break;
+		}
+	} else {
+		val = +1000.0;
+
+		for (unsigned j = 0; j < turns.size(); j++) {
+			BasicPosition<N> child = position;
+			rules.PlayTurn(child, turns[j]);
+			const double n = params.dispersion * noise(gen);
+			wal = SearchChild(rules, position, acc, steps, child, depth - 1, alpha - n, beta - n) + n;
+
+			if (stopped) break;
+			rootScores.push_back(std::make_pair(turns[j], wal - n));
+
+			if (verbose and j > 0 and j % k == 0) printf("[%u/%lu] %.1f s (%lu hashes)\n", j, turns.size(), ((0.001 * (turns.size() - j) / turns.size()) * (SDL_GetTicks() - started)), hashtable.size());
+
+			if (wal < val) {
+				val = wal;
+				score = wal - n;
+				bt = j;
+			}
+			if (val < beta) beta = val;
+			if (alpha >= beta) break;
+		}
+	}
+
+	if (!rootScores.empty()) {
+		result.turn = turns[bt];
+		result.score = score;
+		result.depth = depth;
+		result.found = true;
+	}
+
+	return !stopped;
+}
+
+SearchResult Engine::Search(Board* board, int depth) {
+	if (mcts > 0) {
+		if (!monteCarlo) monteCarlo.reset(new MonteCarlo());
+		return monteCarlo->Search(board, *this);
+	}
+
+	int w = board->getWidth(), h = board->getHeight();
+	SearchResult result;
+
+	switch (BitboardWords(w, h)) {
+		case 1:
+			result = SearchPosition(board, *PositionRulesFor<1>(w, h), depth);
+			break;
+		case 2:
+			result = SearchPosition(board, *PositionRulesFor<2>(w, h), depth);
+			break;
+		default:
+			result = SearchPosition(board, *PositionRulesFor<4>(w, h), depth);
+			break;
+	}
+
+	PROFILE_DUMP(PROFILE_FOLDED, verbose);
+	return result;
+}
+
+template <int N>
+SearchResult Engine::SearchPosition(Board* board, const PositionRules<N>& rules, int depth) {
+	PROFILE_SCOPE(PROFILE_SEARCH);
+
+	SearchResult result;
+	result.found = false;
+	result.book = false;
+	result.score = 0.0;
+	result.depth = 0;
+	result.nodes = 0;
+
+	rootScores.clear();
+	iterations.clear();
+	nodes = 0;
+	stopped = false;
+	started = SDL_GetTicks();
+	if (table) table->NewSearch();
+	evalKey = EvalKey(params, network.get());
+
+	BasicPosition<N> position = board->getPosition().template resize<N>();
+	path = board->getHashHistory();
+
+	// Minmax algorithm with AB-pruning
+	std::vector<Turn> turns;
+	rules.possibleTurns(position, turns);
+	if (!searchTurns.empty()) {
+		turns.erase(std::remove_if(turns.begin(), turns.end(), [this](const Turn& t) {
+			return std::none_of(searchTurns.begin(), searchTurns.end(), [&t](const Turn& u) {
+				return SameTurn(t, u);
+			});
+		}), turns.end());
+	}
+	if (turns.size() == 0) return result;
+
+	if (useBook and book.Probe(board, result.turn)) {
+		for (Turn t : turns) {
+			if (SameTurn(t, result.turn)) {
+				if (verbose) printf("Playing from the opening book.\n");
+				result.found = true;
+				result.book = true;
+				return result;
+			}
+		}
+	}
+
+	if (verbose) printf("Damn, I can do %lu things!\n", turns.size());
+
+	// With sub-plies the depth counts moves, and a whole turn takes up to three of them.
+	const int turnDepth = (subPlies ? 3 : 1);
+
+	if (depth <= -1) depth = (-depth) - std::round(std::log10(turns.size()));
+	if (depth <= 0) depth = turnDepth;
+
+	// Inside the tablebases, every child is a lookup.
+	int value;
+	if (depth > turnDepth and tablebase.Probe(position, value)) {
+		if (verbose) printf("Playing from the tablebases.\n");
+		depth = turnDepth;
+	}
+
+	// The proof-number search gets its own copy of the game, as alpha-beta extends the path.
+	ProofSolver solver;
+	ProofResult proof = { };
+	std::thread prover;
+	solved = false;
+
+	if (proofNodes > 0) {
+		std::vector<std::uint64_t> history = path;
+		prover = std::thread([&, history] {
+			proof = solver.Prove(rules, position, history, proofNodes);
+
+			// A worker searching a slice of the root turns only plays a win from that slice.
+			bool allowed = std::any_of(turns.begin(), turns.end(), [&](const Turn& t) {
+				return SameTurn(t, proof.turn);
+			});
+			if (proof.result == PROOF_WIN and allowed) solved = true;
+		});
+	}
+
+	if (maxNodes == 0 and maxTime == 0) {
+		if (verbose) printf("Evaluating moves up to depth %d.\n", depth);
+		if (SearchRoot(rules, position, turns, depth, result)) {
+			result.nodes = nodes;
+			iterations.push_back(std::make_pair(result, SDL_GetTicks() - started));
+		}
+	} else {
+		// Iterative deepening; an unfinished iteration only counts if nothing was finished before it.
+		for (int d = 1; d <= depth; d++) {
+			SearchResult r = result;
+			bool complete = SearchRoot(rules, position, turns, d, r);
+
+			if (complete or !result.found) result = r;
+			if (!complete) break;
+
+			result.nodes = nodes;
+			iterations.push_back(std::make_pair(result, SDL_GetTicks() - started));
+			if (verbose) printf("Finished depth %d after %.1f seconds.\n", d, 0.001 * (SDL_GetTicks() - started));
+		}
+	}
+
+	if (prover.joinable()) {
+		solver.abort = true;
+		prover.join();
+	}
+
+	if (solved) {
+		if (verbose) printf("Found a forced win after %lu proof nodes.\n", proof.nodes);
+		result.turn = proof.turn;
+		result.score = (position.turn ? +1000.0 : -1000.0);
+		result.found = true;
+	}
+
+	if (verbose) printf("It took me %.1f seconds to compute my move.\n", (0.001 * (SDL_GetTicks() - started)));
+
+	// Out of budget before any root turn was finished, fall back to the first one.
+	if (!result.found) {
+		result.turn = turns[0];
+		result.score = board->Evaluate(params);
+		result.found = true;
+	}
+
+	result.nodes = nodes;
+	return result;
+}
+
+static double* EvalParam(EvalParams& params, const char* name) {
+	if (std::strcmp(name, "PAWN_VALUE") == 0) return &params.pawn;
+	if (std::strcmp(name, "KNIGHT_VALUE") == 0) return &params.knight;
+	if (std::strcmp(name, "PAWN_RESERVE_VALUE") == 0) return &params.pawn_reserve;
+	if (std::strcmp(name, "KNIGHT_RESERVE_VALUE") == 0) return &params.knight_reserve;
+	if (std::strcmp(name, "PAWN_CAPTURE_VALUE") == 0) return &params.pawn_capture;
+	if (std::strcmp(name, "KNIGHT_CAPTURE_VALUE") == 0) return &params.knight_capture;
+	if (std::strcmp(name, "CENTER_POSITION_VALUE") == 0) return &params.center;
+	if (std::strcmp(name, "MOVE_VALUE") == 0) return &params.move;
+	if (std::strcmp(name, "EVAL_DISPERSION") == 0) return &params.dispersion;
+	return nullptr;
+}
+
+bool LoadEvalParams(std::string filename, EvalParams& params) {
+	std::FILE* pFile = std::fopen(filename.c_str(), "r");
+	if (pFile == nullptr) return false;
+
+	char line[256], name[64];
+	double value;
+	bool ok = true;
+
+	while (std::fgets(line, sizeof(line), pFile) != nullptr) {
+		if (line[0] == '#' or line[0] == '\n') continue;
+
+		double* p = nullptr;
+		if (std::sscanf(line, " %63[A-Z_] = %lf", name, &value) == 2 and (p = EvalParam(params, name)) != nullptr) {
+			*p = value;
+		} else {
+			printf("%s: cannot read \"%s\".\n", filename.c_str(), line);
+			ok = false;
+		}
+	}
+
+	std::fclose(pFile);
+	return ok;
+}
+
+bool SaveEvalParams(std::string filename, const EvalParams& params) {
+	std::FILE* pFile = std::fopen(filename.c_str(), "w");
+	if (pFile == nullptr) return false;
+
+	std::fprintf(pFile, "PAWN_VALUE = %.6f\n", params.pawn);
+	std::fprintf(pFile, "KNIGHT_VALUE = %.6f\n", params.knight);
+	std::fprintf(pFile, "PAWN_RESERVE_VALUE = %.6f\n", params.pawn_reserve);
+	std::fprintf(pFile, "KNIGHT_RESERVE_VALUE = %.6f\n", params.knight_reserve);
+	std::fprintf(pFile, "PAWN_CAPTURE_VALUE = %.6f\n", params.pawn_capture);
+	std::fprintf(pFile, "KNIGHT_CAPTURE_VALUE = %.6f\n", params.knight_capture);
+	std::fprintf(pFile, "CENTER_POSITION_VALUE = %.6f\n", params.center);
+	std::fprintf(pFile, "MOVE_VALUE = %.6f\n", params.move);
+	std::fprintf(pFile, "EVAL_DISPERSION = %.6f\n", params.dispersion);
+
+	return std::fclose(pFile) == 0;
+}
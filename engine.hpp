@@ -0,0 +1,135 @@
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "defines.hpp"
+#include "position.hpp"
+
+class Board;
+class EvalCache;
+class MonteCarlo;
+class Network;
+class TranspositionTable;
+struct Accumulator;
+
+template <int N>
+class PositionRules;
+template <int N>
+struct StepTable;
+
+struct SearchResult {
+		Turn turn;
+		double score;
+		int depth;
+		unsigned long nodes;
+		bool found; // false if the side to move has no legal turns
+		bool book; // answered from the opening book
+};
+
+// Alpha-beta searcher. Search() never modifies the board it is given, so separate
+// engines may search separate boards on separate threads. The search itself runs on the
+// narrowest position type that holds the board.
+class Engine {
+	public:
+		Engine();
+		~Engine();
+
+		SearchResult Search(Board* board, int depth);
+
+		bool verbose; // print progress while searching the root
+		bool useBook;
+
+		EvalParams params;
+		std::shared_ptr<const Network> network; // evaluates positions instead of params if set
+
+		// Budgets for iterative deepening up to the requested depth, 0 for none. Without a budget
+		// Search() goes straight to the requested depth.
+		unsigned long maxNodes;
+		unsigned maxTime; // milliseconds
+
+		// Below the root, pairs and triples of moves are only built from the best beam + depth - 1
+		// moves of each piece, so the beam widens with the remaining depth. 0 searches every turn.
+		int beam;
+
+		// Searches a turn as up to three plies of the same side, one move each (see SubPlyPrune), so
+		// alpha-beta can cut bad first moves before their pairs and triples are built. The depth then
+		// counts moves instead of turns, and the beam is not used.
+		bool subPlies;
+
+		// Threads for a Monte Carlo tree search instead of alpha-beta (see mcts.hpp), 0 for alpha-beta.
+		// The depth is then ignored, and the tree is kept for the next search.
+		int mcts;
+
+		// Positions the hashtable keeps per search, 0 for no limit. Once it is full, new positions are
+		// searched but not stored. Each entry takes about HASH_ENTRY_BYTES.
+		std::size_t maxHashEntries;
+
+		// Kept from search to search and shared with every engine (and process) that uses it, instead
+		// of the hashtable of a single search if set. See transposition.hpp.
+		std::shared_ptr<TranspositionTable> table;
+
+		// Static evaluations of this search and earlier ones. Engines that share it keep their
+		// evaluations apart, so it may be shared by any engines; null evaluates every leaf.
+		std::shared_ptr<EvalCache> evalCache;
+
+		// Positions for a proof-number search (see proof.hpp) on a thread of its own next to alpha-beta,
+		// 0 (the default) for none. A win it proves is played as soon as it is found.
+		unsigned long proofNodes;
+
+		// Root turns to search, all of them if empty. Monte Carlo searches search every turn anyway. A
+		// win the proof-number search proves is only played if it is one of them.
+		std::vector<Turn> searchTurns;
+
+		// Root turns with the score they were searched to (exact for the best turn, bounds otherwise).
+		std::vector<std::pair<Turn, double>> rootScores;
+
+		// The result of every depth the last search finished, with the milliseconds it took until then.
+		std::vector<std::pair<SearchResult, unsigned>> iterations;
+
+	protected:
+		template <int N>
+		SearchResult SearchPosition(Board* board, const PositionRules<N>& rules, int depth);
+		template <int N>
+		double AlphaBetaPrune(const PositionRules<N>& rules, const BasicPosition<N>& position, const Accumulator* acc, const StepTable<N>* steps, int depth, double alpha, double beta);
+		template <int N>
+		double FrontierPrune(const PositionRules<N>& rules, const BasicPosition<N>& position, const StepTable<N>& steps, const std::vector<Turn>& turns, double alpha, double beta);
+		template <int N>
+		double SearchChild(const PositionRules<N>& rules, const BasicPosition<N>& parent, const Accumulator* acc, const StepTable<N>& steps, const BasicPosition<N>& child, int depth, double alpha, double beta);
+		template <int N>
+		double SubPlyPrune(const PositionRules<N>& rules, const BasicPosition<N>& position, const Accumulator* acc, const StepTable<N>& steps, const std::vector<Turn>& singles, unsigned from, std::uint64_t hash, Turn& turn, int depth, double alpha, double beta, SearchResult* root);
+		template <int N>
+		double Static(const PositionRules<N>& rules, const BasicPosition<N>& position, const Accumulator* acc, const StepTable<N>* steps);
+		template <int N>
+		bool SearchRoot(const PositionRules<N>& rules, const BasicPosition<N>& position, std::vector<Turn>& turns, int depth, SearchResult& result);
+		bool Stop();
+		bool ProbeTable(std::uint64_t key, int depth, double alpha, double beta, double& score);
+		void StoreTable(std::uint64_t key, int depth, double alpha, double beta, double score);
+
+		std::unordered_map<std::uint64_t, double> hashtable;
+		std::vector<std::uint64_t> path; // hashes of the game so far and the line being searched
+		std::mt19937 gen;
+		std::normal_distribution<double> noise;
+		const std::vector<Turn>* rootTurns; // a sub-ply search may finish at the root, any if null
+		std::uint64_t evalKey; // tells the evaluations of params and network apart in evalCache and table
+		unsigned long nodes;
+		unsigned started;
+		bool stopped;
+		std::atomic<bool> solved; // by the proof-number search, which stops alpha-beta
+
+		std::unique_ptr<MonteCarlo> monteCarlo;
+};
+
+// Evaluation values are stored as "NAME = value" lines, using the names from defines.hpp.
+bool LoadEvalParams(std::string filename, EvalParams& params);
+bool SaveEvalParams(std::string filename, const EvalParams& params);
+
+#endif // ENGINE_HPP
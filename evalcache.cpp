@@ -0,0 +1,47 @@
+#include <cstring>
+
+#include "evalcache.hpp"
+
+const std::uint64_t SLOT_USED = 1ull << 63; // so an empty slot never matches key 0
+
+EvalCache::EvalCache(std::size_t entries) {
+	std::size_t n = 1;
+	while (n * 2 <= entries) n *= 2;
+
+	this->slots = std::vector<Slot>(n);
+	this->mask = n - 1;
+	Clear();
+}
+
+bool EvalCache::Probe(std::uint64_t key, double& score) const {
+	const Slot& s = slots[key & mask];
+	std::uint64_t data = s.data.load(std::memory_order_relaxed);
+	std::uint64_t check = s.check.load(std::memory_order_relaxed);
+
+	if (!(data & SLOT_USED) or (check ^ data) != key) return false;
+
+	float f;
+	std::uint32_t bits = (std::uint32_t) data;
+	std::memcpy(&f, &bits, sizeof(f));
+	score = f;
+	return true;
+}
+
+void EvalCache::Store(std::uint64_t key, double score) {
+	Slot& s = slots[key & mask];
+
+	float f = (float) score;
+	std::uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+
+	std::uint64_t data = SLOT_USED | bits;
+	s.data.store(data, std::memory_order_relaxed);
+	s.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+void EvalCache::Clear() {
+	for (Slot& s : slots) {
+		s.check.store(0, std::memory_order_relaxed);
+		s.data.store(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef EVALCACHE_HPP
+#define EVALCACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Static evaluations by position key, so leaves that come up again in sibling subtrees and later
+// iterations are not evaluated twice. Leaves that WinState decides are kept as +-1000, which is
+// what a leaf is worth either way (see Engine::FrontierPrune). Direct-mapped: every key has one
+// slot, and a new evaluation simply replaces what was there. Slots are written without locks like
+// TableEntry, the value next to the key xor the value, so engines on several threads may share a
+// cache, and a torn write just misses. The key has to tell evaluations apart too, see
+// Engine::Static.
+class EvalCache {
+	public:
+		// Rounded down to a power of two.
+		explicit EvalCache(std::size_t entries);
+
+		bool Probe(std::uint64_t key, double& score) const;
+		void Store(std::uint64_t key, double score);
+		void Clear();
+
+		inline std::size_t size() const {
+			return slots.size();
+		}
+
+	protected:
+		struct Slot {
+				std::atomic<std::uint64_t> check;
+				std::atomic<std::uint64_t> data;
+		};
+
+		std::vector<Slot> slots;
+		std::uint64_t mask;
+};
+
+#endif // EVALCACHE_HPP
@@ -0,0 +1,219 @@
+#ifndef GEOMETRY_HPP
+#define GEOMETRY_HPP
+
+#include <cstdint>
+#include <utility>
+
+// Boards can be up to 16 tiles in either direction (turns store coordinates in 4 bits).
+const int BOARD_MAX_SIZE = 16;
+const int BITBOARD_MAX_WORDS = (BOARD_MAX_SIZE * BOARD_MAX_SIZE + 63) / 64;
+
+// Board sizes that get a rules kernel specialized at compile time. Any other size up to
+// BOARD_MAX_SIZE uses a generic kernel that reads its dimensions at runtime.
+// Bitboards come in 64, 128 and 256 bits.
+constexpr int BitboardWords(int width, int height) {
+	return (width * height <= 64 ? 1 : (width * height <= 128 ? 2 : 4));
+}
+
+#define BOARD_SIZES(X) \
+	X(9, 7) \
+	X(7, 5) \
+	X(11, 9) \
+	X(13, 11) \
+	X(16, 16)
+
+// Calls f(0), f(1), ..., f(N - 1) with compile-time constants instead of looping.
+template <typename F, int ... I>
+inline void Unroll(F&& f, std::integer_sequence<int, I...>) {
+	(f(std::integral_constant<int, I>()), ...);
+}
+
+template <int N, typename F>
+inline void Unroll(F&& f) {
+	Unroll(f, std::make_integer_sequence<int, N>());
+}
+
+// A set of tiles, with tile (x, y) at bit y * width + x. One word covers the classical 9x7 board,
+// larger boards use 128 or 256 bits. Like the positions that hold them, bitboards are plain data:
+// initialize them with {} to start out empty.
+template <int N>
+struct Bitboard {
+		std::uint64_t w[N];
+
+		constexpr bool test(int i) const {
+			return (w[i >> 6] >> (i & 63)) & 1;
+		}
+
+		constexpr void set(int i) {
+			w[i >> 6] |= 1ull << (i & 63);
+		}
+
+		constexpr void reset(int i) {
+			w[i >> 6] &= ~(1ull << (i & 63));
+		}
+
+		inline bool any() const {
+			std::uint64_t r = 0;
+			for (int i = 0; i < N; i++) {
+				r |= w[i];
+			}
+			return r != 0;
+		}
+
+		inline int count() const {
+			int c = 0;
+			for (int i = 0; i < N; i++) {
+				c += __builtin_popcountll(w[i]);
+			}
+			return c;
+		}
+
+		inline Bitboard operator&(const Bitboard& b) const {
+			Bitboard r = { };
+			for (int i = 0; i < N; i++) {
+				r.w[i] = w[i] & b.w[i];
+			}
+			return r;
+		}
+
+		inline Bitboard operator|(const Bitboard& b) const {
+			Bitboard r = { };
+			for (int i = 0; i < N; i++) {
+				r.w[i] = w[i] | b.w[i];
+			}
+			return r;
+		}
+
+		// Calls f(i) for every tile i in the set, in increasing order.
+		template <typename F>
+		inline void forEach(F f) const {
+			for (int i = 0; i < N; i++) {
+				for (std::uint64_t b = w[i]; b != 0; b &= b - 1) {
+					f(64 * i + __builtin_ctzll(b));
+				}
+			}
+		}
+
+		// The first M words, or this set padded with empty words.
+		template <int M>
+		inline Bitboard<M> resize() const {
+			Bitboard<M> r = { };
+			for (int i = 0; i < N and i < M; i++) {
+				r.w[i] = w[i];
+			}
+			return r;
+		}
+};
+
+// A single step a piece can make: pawns move one tile orthogonally, knights also move one tile
+// diagonally or two tiles orthogonally.
+template <int N>
+struct Step {
+		int to; // target tile, -1 if it is off the board
+		bool knight; // only knights can make this step
+		Bitboard<N> path; // tiles that have to be empty
+		Bitboard<N> guard; // tiles that may not hold an enemy (skirmish rule)
+};
+
+const int STEP_COUNT = 12;
+
+// Steps in the order Piece::getLegalMoves has always listed them: by dx, then by dy.
+const int STEP_DX[STEP_COUNT] = { -2, -1, -1, -1, 0, 0, 0, 0, 1, 1, 1, 2 };
+const int STEP_DY[STEP_COUNT] = { 0, -1, 0, 1, -2, -1, 1, 2, -1, 0, 1, 0 };
+
+template <int N, int S>
+struct SquareTables {
+		Bitboard<N> around[S]; // the tile itself and its (up to) 8 neighbours
+		Bitboard<N> reach[S]; // tiles up to three steps away, the only ones the moves of a piece there depend on
+		Step<N> steps[S][STEP_COUNT];
+};
+
+template <int N, int S>
+constexpr SquareTables<N, S> MakeSquareTables(int width, int height) {
+	SquareTables<N, S> t = { };
+
+	auto add = [width, height](Bitboard<N>& b, int x, int y) {
+		if (x >= 0 and y >= 0 and x < width and y < height) b.set(y * width + x);
+	};
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int sq = y * width + x;
+
+			for (int i = -1; i <= 1; i++) {
+				for (int j = -1; j <= 1; j++) {
+					add(t.around[sq], x + i, y + j);
+				}
+			}
+
+			for (int i = -3; i <= 3; i++) {
+				for (int j = -3; j <= 3; j++) {
+					add(t.reach[sq], x + i, y + j);
+				}
+			}
+
+			for (int k = 0; k < STEP_COUNT; k++) {
+				int dx = STEP_DX[k], dy = STEP_DY[k];
+				int nx = x + dx, ny = y + dy;
+				Step<N>& s = t.steps[sq][k];
+				s.to = -1;
+				s.knight = false;
+
+				if (nx < 0 or ny < 0 or nx >= width or ny >= height) continue;
+
+				s.to = ny * width + nx;
+				s.knight = (dx * dx + dy * dy > 1);
+
+				// Pieces cannot pass an enemy, only move away from it.
+				if (dy == 0 and (dx == 1 or dx == -1)) {
+					add(s.guard, x, y + 1);
+					add(s.guard, x, y - 1);
+				} else if (dx == 0 and (dy == 1 or dy == -1)) {
+					add(s.guard, x + 1, y);
+					add(s.guard, x - 1, y);
+				} else if (dy == 0) {
+					add(s.path, x + dx / 2, y);
+					add(s.guard, x + dx / 2, y + 1);
+					add(s.guard, x + dx / 2, y - 1);
+					add(s.guard, x, y + 1);
+					add(s.guard, x, y - 1);
+				} else if (dx == 0) {
+					add(s.path, x, y + dy / 2);
+					add(s.guard, x + 1, y + dy / 2);
+					add(s.guard, x - 1, y + dy / 2);
+					add(s.guard, x + 1, y);
+					add(s.guard, x - 1, y);
+				} else {
+					add(s.guard, x + dx, y);
+					add(s.guard, x, y + 1);
+					add(s.guard, x, y - 1);
+				}
+			}
+		}
+	}
+
+	return t;
+}
+
+// Tables for a board size known at compile time.
+template <int W, int H>
+struct Geometry {
+		static constexpr int width = W;
+		static constexpr int height = H;
+		static constexpr int words = BitboardWords(W, H);
+		static constexpr SquareTables<words, W * H> tables = MakeSquareTables<words, W * H>(W, H);
+};
+
+// Tables for any other board size, computed when they are first needed.
+template <int N>
+struct DynamicGeometry {
+		DynamicGeometry(int width, int height) :
+				width(width), height(height), tables(MakeSquareTables<N, 64 * N>(width, height)) {
+		}
+
+		int width, height;
+		static constexpr int words = N;
+		SquareTables<N, 64 * N> tables;
+};
+
+#endif // GEOMETRY_HPP
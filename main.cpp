@@ -1,10 +1,180 @@
 #include <SDL2/SDL.h>
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
 
+#include <unistd.h>
+
+#include "batch.hpp"
 #include "board.hpp"
+#include "book.hpp"
+#include "database.hpp"
+#include "distribute.hpp"
+#include "engine.hpp"
+#include "match.hpp"
+#include "nnue.hpp"
+#include "record.hpp"
+#include "server.hpp"
+#include "tactics.hpp"
+#include "tablebase.hpp"
+#include "transposition.hpp"
+#include "tune.hpp"
 #include "utils.hpp"
 
+static int intArg(int argc, char* argv[], int i, int fallback) {
+	return (i < argc ? std::atoi(argv[i]) : fallback);
+}
+
 int main(int argc, char* argv[]) {
+	// Commands below run without a window, keep their progress visible when piped.
+	std::setvbuf(stdout, nullptr, _IOLBF, 0);
+
+	if (argc > 1 and std::strcmp(argv[1], "book") == 0) {
+		if (argc < 3) {
+			std::printf("Usage: %s book <file> [plies] [breadth] [depth] [threads]\n", argv[0]);
+			return 1;
+		}
+
+		return BuildBook(argv[2], intArg(argc, argv, 3, 4), intArg(argc, argv, 4, 3), intArg(argc, argv, 5, 3), intArg(argc, argv, 6, 0)) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "batch") == 0) {
+		if (argc < 3) {
+			std::printf("Usage: %s batch <depth> [threads] [input] [output]\n", argv[0]);
+			return 1;
+		}
+
+		return AnalyseBatch(argc > 4 ? argv[4] : "-", argc > 5 ? argv[5] : "-", std::atoi(argv[2]), intArg(argc, argv, 3, 0)) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "coordinator") == 0) {
+		if (argc < 4) {
+			std::printf("Usage: %s coordinator <port> <depth> [chunk] [slices] [input] [output]\n", argv[0]);
+			return 1;
+		}
+
+		return RunCoordinator(argc > 6 ? argv[6] : "-", argc > 7 ? argv[7] : "-", std::atoi(argv[2]), std::atoi(argv[3]), intArg(argc, argv, 4, DISTRIBUTE_CHUNK), intArg(argc, argv, 5, 1)) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "worker") == 0) {
+		if (argc < 4) {
+			std::printf("Usage: %s worker <host> <port> [threads]\n", argv[0]);
+			return 1;
+		}
+
+		return RunWorker(argv[2], std::atoi(argv[3]), intArg(argc, argv, 4, 0)) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "match") == 0) {
+		MatchOptions options;
+		if (!ParseMatchOptions(argc - 2, argv + 2, options)) {
+			std::printf("Usage: %s match [games=N] [threads=N] [openings=plies] [maxplies=N] [seed=N] [elo0=E] [elo1=E] [alpha=P] [beta=P] [record=file] [[a.|b.]params=file] [[a.|b.]nnue=file] [[a.|b.]depth=N] [[a.|b.]nodes=N] [[a.|b.]time=ms] [[a.|b.]beam=N] [[a.|b.]subply=0|1] [[a.|b.]mcts=threads] [[a.|b.]proof=N]\n", argv[0]);
+			return 1;
+		}
+
+		return RunMatch(options) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "server") == 0) {
+		if (argc < 3) {
+			std::printf("Usage: %s server <socket|-> [threads] [hash megabytes per game, or of the shared table] [table file]\n", argv[0]);
+			return 1;
+		}
+
+		return RunServer(argv[2], intArg(argc, argv, 3, 0), intArg(argc, argv, 4, SERVER_HASH_MEGABYTES), (argc > 5 ? argv[5] : "")) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "selfplay") == 0) {
+		if (argc < 3) {
+			std::printf("Usage: %s selfplay <prefix> [games] [depth] [threads]\n", argv[0]);
+			return 1;
+		}
+
+		return GenerateSamples(argv[2], intArg(argc, argv, 3, 100), intArg(argc, argv, 4, 2), intArg(argc, argv, 5, 0)) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "tune") == 0) {
+		if (argc < 4) {
+			std::printf("Usage: %s tune <output> <shard>...\n", argv[0]);
+			return 1;
+		}
+
+		return TuneEvalParams(argv[2], std::vector<std::string>(argv + 3, argv + argc), TUNE_ITERATIONS) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "convert") == 0) {
+		if (argc < 4) {
+			std::printf("Usage: %s convert <archive> <game.txt>...\n", argv[0]);
+			return 1;
+		}
+
+		return ConvertGames(argv[2], std::vector<std::string>(argv + 3, argv + argc)) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "replay") == 0) {
+		if (argc < 3) {
+			std::printf("Usage: %s replay <archive>\n", argv[0]);
+			return 1;
+		}
+
+		return ReplayGames(argv[2]) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "database") == 0) {
+		if (argc < 4) {
+			std::printf("Usage: %s database <database> <archive>...\n", argv[0]);
+			return 1;
+		}
+
+		return BuildDatabase(argv[2], std::vector<std::string>(argv + 3, argv + argc), 0) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "query") == 0) {
+		if (argc < 4) {
+			std::printf("Usage: %s query <database> <position>\n", argv[0]);
+			return 1;
+		}
+
+		// Positions contain spaces, so the rest of the arguments are one position.
+		std::string position = argv[3];
+		for (int i = 4; i < argc; i++) {
+			position += std::string(" ") + argv[i];
+		}
+
+		return QueryDatabase(argv[2], position) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "tablebase") == 0) {
+		if (argc < 4) {
+			std::printf("Usage: %s tablebase <directory> <pieces> [threads] [width] [height]\n", argv[0]);
+			return 1;
+		}
+
+		return BuildTablebases(argv[2], std::atoi(argv[3]), intArg(argc, argv, 4, 0), intArg(argc, argv, 5, DEFAULT_WIDTH), intArg(argc, argv, 6, DEFAULT_HEIGHT)) ? 0 : 1;
+	}
+
+	if (argc > 1 and std::strcmp(argv[1], "tactics") == 0) {
+		EngineConfig config = DefaultEngineConfig();
+		config.time = TACTICS_TIME;
+		bool ok = argc >= 3;
+
+		for (int i = 3; i < argc and ok; i++) {
+			const char* eq = std::strchr(argv[i], '=');
+			ok = eq != nullptr and SetEngineOption(config, std::string(argv[i], eq - argv[i]).c_str(), eq + 1);
+		}
+
+		if (!ok) {
+			std::printf("Usage: %s tactics <suite> [time=ms] [nodes=N] [depth=N] [params=file] [nnue=file] [beam=N] [subply=0|1] [mcts=threads] [proof=N]\n", argv[0]);
+			return 1;
+		}
+
+		if (config.depth <= 0) config.depth = (config.nodes > 0 or config.time > 0) ? 64 : 1;
+		return RunTactics(argv[2], config) ? 0 : 1;
+	}
+
 	if (SDL_Init(SDL_INIT_EVERYTHING) == -1) {
 		std::printf("Failed to initialize SDL: %s.\n", SDL_GetError());
 		return 1;
@@ -21,7 +191,7 @@ int main(int argc, char* argv[]) {
 		return 1;
 	}
 
-	SDL_Renderer* context = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+	SDL_Renderer* context = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE);
 
 	std::printf("Created SDL Window.\n");
 
@@ -29,14 +199,46 @@ int main(int argc, char* argv[]) {
 		std::printf("Failed to load textures: %s.\n", SDL_GetError());
 	}
 
+	if (book.Open("book.bin")) {
+		std::printf("Loaded opening book with %lu positions.\n", book.size());
+	}
+
+	int tables = tablebase.Open("tablebases");
+	if (tables > 0) {
+		std::printf("Loaded %d tablebases with up to %d pieces.\n", tables, tablebase.getMaxPieces());
+	}
+
+	Engine engine; // keeps the Monte Carlo tree between turns
+	engine.verbose = true;
+	engine.proofNodes = PROOF_NODES;
+
+	if (LoadEvalParams("eval.txt", engine.params)) {
+		std::printf("Loaded evaluation values from eval.txt.\n");
+	}
+
+	std::shared_ptr<Network> network(new Network());
+	if (network->Open("nnue.bin")) {
+		std::printf("Loaded neural network evaluation from nnue.bin.\n");
+		engine.network = network;
+	}
+
+	// What was searched for one turn is kept for the next ones, and across restarts in table.bin.
+	engine.table = std::make_shared<TranspositionTable>();
+	if (access("table.bin", F_OK) == 0 and engine.table->Open("table.bin", TABLE_MEGABYTES)) {
+		std::printf("Opened transposition table table.bin with %lu entries.\n", engine.table->size());
+	} else if (!engine.table->Create(TABLE_MEGABYTES)) {
+		engine.table.reset();
+	}
+
 	bool running = true;
+	bool hover = false; // the cursor only animates while the mouse is over the window
 	int depth = -6;
 	SDL_Event e;
 	while (running) {
-		bool didTick = false;
+		// Sleep until there is input, or until the cursor needs its next frame.
+		int events = (hover ? SDL_WaitEventTimeout(&e, FRAME_INTERVAL) : SDL_WaitEvent(&e));
 
-		while (SDL_PollEvent(&e)) {
-			didTick = true;
+		while (events > 0) {
 			if (e.type == SDL_QUIT) {
 				printf("Quitting!\n");
 				running = false;
@@ -69,7 +271,7 @@ int main(int argc, char* argv[]) {
 
 					case SDLK_d:
 					case SDLK_KP_8:
-						board.ComputeTurn(depth);
+						board.ComputeTurn(engine, depth);
 						printf("Current evaluation: %.1f\n", board.Evaluate());
 						printf("%s\n", board.summary().c_str());
 						break;
@@ -87,19 +289,41 @@ int main(int argc, char* argv[]) {
 						printf("Decreasing evaluation depth to %d.\n", depth);
 						break;
 
+					case SDLK_m:
+						engine.mcts = (engine.mcts > 0 ? 0 : std::max(1u, std::thread::hardware_concurrency()));
+						if (engine.mcts > 0) printf("Switching to Monte Carlo tree search on %d threads.\n", engine.mcts);
+						else printf("Switching to alpha-beta search.\n");
+						break;
+
 					case SDLK_s:
 						printf("Saving game.\n");
 						board.SaveGame("sutran.txt");
+						SaveRecord(&board, "sutran.sgr");
+						break;
+
+					case SDLK_l:
+						if (board.LoadGame("sutran.txt")) {
+							printf("Loaded game.\n%s\n", board.summary().c_str());
+						} else {
+							printf("Failed to load sutran.txt.\n");
+						}
 						break;
 
 					default:
 						break;
 				}
+			} else if (e.type == SDL_MOUSEBUTTONDOWN) {
+				if (e.button.button == SDL_BUTTON_LEFT or e.button.button == SDL_BUTTON_RIGHT) {
+					board.Click(e.button.x / TEX_WIDTH, e.button.y / TEX_HEIGHT, e.button.button == SDL_BUTTON_RIGHT);
+				}
+			} else if (e.type == SDL_WINDOWEVENT) {
+				if (e.window.event == SDL_WINDOWEVENT_ENTER) hover = true;
+				else if (e.window.event == SDL_WINDOWEVENT_LEAVE) hover = false;
+			} else if (e.type == SDL_RENDER_TARGETS_RESET or e.type == SDL_RENDER_DEVICE_RESET) {
+				board.ResetTextures();
 			}
-		}
 
-		if (not didTick) {
-			SDL_Delay(1);
+			events = SDL_PollEvent(&e);
 		}
 
 		SDL_RenderClear(context);
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "engine.hpp"
+#include "match.hpp"
+#include "nnue.hpp"
+#include "record.hpp"
+
+struct MatchState {
+		std::mutex lock;
+		std::atomic<int> next;
+		std::atomic<bool> stop;
+		int wins, draws, losses; // from engine a's point of view
+		RecordWriter writer;
+		bool recording;
+		unsigned start;
+};
+
+EngineConfig DefaultEngineConfig() {
+	EngineConfig config;
+	config.depth = 0;
+	config.nodes = 0;
+	config.time = 0;
+	config.beam = 0;
+	config.subPlies = false;
+	config.mcts = 0;
+	config.proof = 0;
+	return config;
+}
+
+bool SetEngineOption(EngineConfig& config, const char* key, const char* value) {
+	if (std::strcmp(key, "params") == 0) return LoadEvalParams(value, config.params);
+	if (std::strcmp(key, "nnue") == 0) {
+		std::shared_ptr<Network> network(new Network());
+		if (!network->Open(value)) return false;
+		config.network = network;
+		return true;
+	}
+	if (std::strcmp(key, "depth") == 0) config.depth = std::atoi(value);
+	else if (std::strcmp(key, "nodes") == 0) config.nodes = std::strtoul(value, nullptr, 10);
+	else if (std::strcmp(key, "time") == 0) config.time = std::strtoul(value, nullptr, 10);
+	else if (std::strcmp(key, "beam") == 0) config.beam = std::atoi(value);
+	else if (std::strcmp(key, "subply") == 0) config.subPlies = std::atoi(value) != 0;
+	else if (std::strcmp(key, "mcts") == 0) config.mcts = std::atoi(value);
+	else if (std::strcmp(key, "proof") == 0) config.proof = std::strtoul(value, nullptr, 10);
+	else return false;
+
+	return true;
+}
+
+bool ParseMatchOptions(int argc, char* argv[], MatchOptions& options) {
+	options.a = DefaultEngineConfig();
+	options.b = options.a;
+
+	options.games = 1000;
+	options.threads = 0;
+	options.openings = 4;
+	options.maxPlies = 200;
+	options.seed = 1;
+	options.elo0 = 0.0;
+	options.elo1 = 10.0;
+	options.alpha = 0.05;
+	options.beta = 0.05;
+	options.record = "";
+
+	for (int i = 0; i < argc; i++) {
+		std::string arg = argv[i];
+		std::size_t eq = arg.find('=');
+		if (eq == std::string::npos) {
+			printf("Expected key=value, got \"%s\".\n", argv[i]);
+			return false;
+		}
+
+		std::string key = arg.substr(0, eq);
+		const char* value = argv[i] + eq + 1;
+		bool ok = true;
+
+		if (key.compare(0, 2, "a.") == 0) ok = SetEngineOption(options.a, key.c_str() + 2, value);
+		else if (key.compare(0, 2, "b.") == 0) ok = SetEngineOption(options.b, key.c_str() + 2, value);
+		else if (key == "games") options.games = std::atoi(value);
+		else if (key == "threads") options.threads = std::atoi(value);
+		else if (key == "openings") options.openings = std::atoi(value);
+		else if (key == "maxplies") options.maxPlies = std::atoi(value);
+		else if (key == "seed") options.seed = std::strtoul(value, nullptr, 10);
+		else if (key == "elo0") options.elo0 = std::atof(value);
+		else if (key == "elo1") options.elo1 = std::atof(value);
+		else if (key == "alpha") options.alpha = std::atof(value);
+		else if (key == "beta") options.beta = std::atof(value);
+		else if (key == "record") options.record = value;
+		else ok = SetEngineOption(options.a, key.c_str(), value) and SetEngineOption(options.b, key.c_str(), value);
+
+		if (!ok) {
+			printf("Cannot use \"%s\".\n", argv[i]);
+			return false;
+		}
+	}
+
+	// With a node or time budget the engines deepen until the budget runs out.
+	for (EngineConfig* c : { &options.a, &options.b }) {
+		if (c->depth <= 0) c->depth = (c->nodes > 0 or c->time > 0) ? 64 : 1;
+	}
+
+	return true;
+}
+
+// The same turn can list its moves in any order, depending on the piece order of the board.
+static PackedTurn TurnKey(const Turn& t) {
+	PackedTurn p = PackTurn(t);
+	PackedTurn m[3] = { p & 0xFFFF, (p >> 16) & 0xFFFF, (p >> 32) & 0xFFFF };
+
+	for (int i = 1; i < t.move_count and i < 3; i++) {
+		for (int j = i; j > 0 and m[j] < m[j - 1]; j--) {
+			std::swap(m[j], m[j - 1]);
+		}
+	}
+
+	return (p & ~0xFFFFFFFFFFFFull) | m[0] | m[1] << 16 | m[2] << 32;
+}
+
+static void PlayOpening(Board* board, unsigned seed, int plies) {
+	std::mt19937 rng(seed);
+
+	for (int i = 0; i < plies and board->WinState() == WINSTATE_NONE; i++) {
+		std::vector<Turn> turns = board->possibleTurns();
+		if (turns.empty()) break;
+
+		std::sort(turns.begin(), turns.end(), [](const Turn& a, const Turn& b) {
+			return TurnKey(a) < TurnKey(b);
+		});
+
+		board->PlayTurn(turns[rng() % turns.size()]);
+	}
+}
+
+void ConfigureEngine(Engine& engine, const EngineConfig& config) {
+	engine.params = config.params;
+	engine.network = config.network;
+	engine.maxNodes = config.nodes;
+	engine.maxTime = config.time;
+	engine.beam = config.beam;
+	engine.subPlies = config.subPlies;
+	engine.mcts = config.mcts;
+	engine.proofNodes = config.proof;
+	engine.useBook = false;
+}
+
+static int PlayGame(Board* board, Engine& white, Engine& black, const EngineConfig& wc, const EngineConfig& bc, int maxPlies) {
+	for (int ply = 0;; ply++) {
+		int state = board->WinState();
+		if (state != WINSTATE_NONE) return state;
+		if (ply >= maxPlies) return WINSTATE_DRAW;
+
+		bool turn = board->getTurn();
+		SearchResult r = (turn ? white.Search(board, wc.depth) : black.Search(board, bc.depth));
+		if (!r.found) return (turn ? WINSTATE_BLACK : WINSTATE_WHITE);
+
+		board->PlayTurn(r.turn);
+	}
+}
+
+// Generalized SPRT log-likelihood ratio for the logistic Elo model, from the mean and variance of
+// the game scores.
+static double SprtLLR(int wins, int draws, int losses, double elo0, double elo1) {
+	double n = wins + draws + losses;
+	if (n == 0) return 0.0;
+
+	double w = wins / n, d = draws / n, l = losses / n;
+	double s = w + d / 2.0;
+	double var = w * (1.0 - s) * (1.0 - s) + d * (0.5 - s) * (0.5 - s) + l * s * s;
+	if (var <= 0.0) return 0.0;
+
+	double s0 = 1.0 / (1.0 + std::pow(10.0, -elo0 / 400.0));
+	double s1 = 1.0 / (1.0 + std::pow(10.0, -elo1 / 400.0));
+	return n * (s1 - s0) * (2.0 * s - s0 - s1) / (2.0 * var);
+}
+
+static double ScoreToElo(double s) {
+	s = std::min(std::max(s, 1e-6), 1.0 - 1e-6);
+	return -400.0 * std::log10(1.0 / s - 1.0);
+}
+
+static void MatchWorker(MatchState& state, const MatchOptions& options) {
+	Engine a, b;
+	ConfigureEngine(a, options.a);
+	ConfigureEngine(b, options.b);
+
+	const double lower = std::log(options.beta / (1.0 - options.alpha));
+	const double upper = std::log((1.0 - options.beta) / options.alpha);
+
+	int game;
+	while (!state.stop and (game = state.next++) < options.games) {
+		// Each pair of games shares an opening, with a playing white in the first one.
+		bool aWhite = (game % 2 == 0);
+
+		Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+		board.NewGame(DEFAULT_PAWNS, DEFAULT_KNIGHTS, DEFAULT_FLANKING);
+		PlayOpening(&board, options.seed + game / 2, options.openings);
+
+		int result = (aWhite ? PlayGame(&board, a, b, options.a, options.b, options.maxPlies) : PlayGame(&board, b, a, options.b, options.a, options.maxPlies));
+
+		std::lock_guard<std::mutex> guard(state.lock);
+		if (state.stop) break;
+
+		if (result == WINSTATE_DRAW) state.draws++;
+		else if ((result == WINSTATE_WHITE) == aWhite) state.wins++;
+		else state.losses++;
+
+		if (state.recording) {
+			state.writer.BeginGame(board.getWidth(), board.getHeight(), board.getStartPosition());
+			for (const Turn& t : board.getTurnHistory()) {
+				state.writer.WriteTurn(t);
+			}
+			state.writer.EndGame(result);
+		}
+
+		int n = state.wins + state.draws + state.losses;
+		double s = (state.wins + 0.5 * state.draws) / n;
+		double var = (state.wins * (1.0 - s) * (1.0 - s) + state.draws * (0.5 - s) * (0.5 - s) + state.losses * s * s) / n;
+		double margin = 1.96 * std::sqrt(var / n);
+		double llr = SprtLLR(state.wins, state.draws, state.losses, options.elo0, options.elo1);
+
+		printf("Games %d: +%d =%d -%d, Elo %.1f [%.1f, %.1f], LLR %.2f [%.2f, %.2f], %.0f s\n", n, state.wins, state.draws, state.losses, ScoreToElo(s), ScoreToElo(s - margin), ScoreToElo(s + margin), llr, lower, upper, 0.001 * (SDL_GetTicks() - state.start));
+
+		if (llr >= upper) {
+			printf("SPRT: H1 accepted, a is at least %.1f Elo stronger than b.\n", options.elo1);
+			state.stop = true;
+		} else if (llr <= lower) {
+			printf("SPRT: H0 accepted, a is not %.1f Elo stronger than b.\n", options.elo1);
+			state.stop = true;
+		}
+	}
+}
+
+bool RunMatch(const MatchOptions& options) {
+	int threads = options.threads;
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	MatchState state;
+	state.next = 0;
+	state.stop = false;
+	state.wins = 0;
+	state.draws = 0;
+	state.losses = 0;
+	state.start = SDL_GetTicks();
+	state.recording = !options.record.empty();
+
+	if (state.recording and !state.writer.Open(options.record)) {
+		printf("Failed to open %s for writing.\n", options.record.c_str());
+		return false;
+	}
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.push_back(std::thread(MatchWorker, std::ref(state), std::cref(options)));
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	if (!state.stop) printf("SPRT: no decision after %d games.\n", state.wins + state.draws + state.losses);
+
+	return state.writer.Close();
+}
@@ -0,0 +1,46 @@
+#ifndef MATCH_HPP
+#define MATCH_HPP
+
+#include <memory>
+#include <string>
+
+#include "defines.hpp"
+
+class Engine;
+class Network;
+
+struct EngineConfig {
+		EvalParams params;
+		std::shared_ptr<const Network> network; // nnue=<file>, shared by the engine's games
+		int depth;
+		unsigned long nodes;
+		unsigned time; // milliseconds per turn
+		int beam; // see Engine::beam
+		bool subPlies; // see Engine::subPlies
+		int mcts; // see Engine::mcts
+		unsigned long proof; // see Engine::proofNodes
+};
+
+struct MatchOptions {
+		EngineConfig a, b;
+		int games, threads, openings, maxPlies;
+		unsigned seed;
+		double elo0, elo1, alpha, beta;
+		std::string record;
+};
+
+// Depth 0, no budgets, every turn and no proof-number search.
+EngineConfig DefaultEngineConfig();
+
+// Applies one engine option of a match ("depth", "time", "params" and so on, without "a." or "b.").
+bool SetEngineOption(EngineConfig& config, const char* key, const char* value);
+void ConfigureEngine(Engine& engine, const EngineConfig& config);
+
+// Reads "key=value" arguments; keys prefixed with "a." or "b." only apply to that engine.
+bool ParseMatchOptions(int argc, char* argv[], MatchOptions& options);
+
+// Plays pairs of games between engines a and b from the same random opening with colours swapped,
+// until `games` games are played or the SPRT of elo0 against elo1 accepts either hypothesis.
+bool RunMatch(const MatchOptions& options);
+
+#endif // MATCH_HPP
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "mcts.hpp"
+#include "nnue.hpp"
+#include "rules.hpp"
+
+const std::uint32_t NO_NODES = UINT32_MAX;
+
+static inline void InitNode(MonteCarloNode& node, PackedTurn turn) {
+	node.turn = turn;
+	node.visits.store(0);
+	node.score.store(0);
+	node.first = 0;
+	node.count = 0;
+	node.state.store(NODE_LEAF);
+}
+
+// Captures are listed first, and they are the only turns that move onto an occupied tile.
+template <int N>
+static inline int CountCaptures(const BasicPosition<N>& p, const std::vector<Turn>& turns) {
+	int n = 0;
+	while (n < (int) turns.size() and !(turns[n].flags & TURN_REINFORCE) and p.occupied(p.tile(turns[n].moves[0].x2, turns[n].moves[0].y2))) {
+		n++;
+	}
+
+	return n;
+}
+
+MonteCarlo::MonteCarlo() : used(0), playouts(0), maxDepth(0) {
+	this->root = 0;
+	this->rootPosition = { };
+	this->hasTree = false;
+	this->maxPlayouts = 0;
+	this->maxTime = 0;
+	this->started = 0;
+	this->beam = 0;
+}
+
+void MonteCarlo::Reset(const WidePosition& position) {
+	if (!pool) pool.reset(new MonteCarloNode[MCTS_POOL_NODES]);
+
+	used = 1;
+	root = 0;
+	InitNode(pool[root], 0);
+	rootPosition = position;
+	hasTree = true;
+}
+
+std::uint32_t MonteCarlo::Allocate(std::uint32_t count) {
+	std::uint32_t at = used.fetch_add(count);
+	if (at > MCTS_POOL_NODES or MCTS_POOL_NODES - at < count) return NO_NODES;
+	return at;
+}
+
+MonteCarloNode* MonteCarlo::Select(MonteCarloNode& node) {
+	double logn = std::log((double) node.visits.load() + 1.0);
+	MonteCarloNode* best = nullptr;
+	double bestValue = -1.0;
+
+	for (std::uint32_t i = 0; i < node.count; i++) {
+		MonteCarloNode& c = pool[node.first + i];
+		std::uint32_t v = c.visits.load();
+		if (v == 0) return &c;
+
+		double value = c.score.load() / (2.0 * v) + MCTS_EXPLORATION * std::sqrt(logn / v);
+		if (value > bestValue) {
+			bestValue = value;
+			best = &c;
+		}
+	}
+
+	return best;
+}
+
+bool MonteCarlo::Stop() {
+	if (maxPlayouts > 0 and playouts >= maxPlayouts) return true;
+	return maxTime > 0 and SDL_GetTicks() - started >= maxTime;
+}
+
+// Makes the node of the given position the root if it is the old root or one of the two plies below
+// it. Otherwise (or once the pool is mostly used up) the search starts over.
+template <int N>
+bool MonteCarlo::Reuse(const PositionRules<N>& rules, const WidePosition& position) {
+	if (!hasTree or rootPosition.width != position.width or rootPosition.height != position.height) return false;
+	if (used > MCTS_POOL_NODES / 4 * 3) return false;
+
+	const std::uint64_t target = position.hash();
+	const BasicPosition<N> start = rootPosition.template resize<N>();
+	if (start.hash() == target) return true;
+
+	const MonteCarloNode& r = pool[root];
+	if (r.state != NODE_EXPANDED) return false;
+
+	for (std::uint32_t i = 0; i < r.count; i++) {
+		const MonteCarloNode& a = pool[r.first + i];
+		BasicPosition<N> pa = start;
+		rules.PlayTurn(pa, UnpackTurn(a.turn));
+
+		std::uint32_t found = NO_NODES;
+		if (pa.hash() == target) found = r.first + i;
+
+		for (std::uint32_t j = 0; found == NO_NODES and a.state == NODE_EXPANDED and j < a.count; j++) {
+			BasicPosition<N> pb = pa;
+			rules.PlayTurn(pb, UnpackTurn(pool[a.first + j].turn));
+			if (pb.hash() == target) found = a.first + j;
+		}
+
+		if (found != NO_NODES) {
+			root = found;
+			rootPosition = position;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Gives a node its children; with `all` it lists every turn, and keeps the statistics of the
+// children the node already had.
+template <int N>
+void MonteCarlo::Expand(MonteCarloNode& node, const PositionRules<N>& rules, const BasicPosition<N>& p, bool all, std::mt19937& rng, std::vector<Turn>& turns) {
+	turns.clear();
+	if (rules.WinState(p) == WINSTATE_NONE) rules.possibleTurns(p, turns, (all ? 0 : beam));
+
+	int keep = turns.size();
+	if (!all and keep > MCTS_CHILDREN) {
+		int i = std::min(CountCaptures(p, turns), MCTS_CHILDREN);
+		for (; i < MCTS_CHILDREN; i++) {
+			std::swap(turns[i], turns[i + rng() % (keep - i)]);
+		}
+
+		keep = MCTS_CHILDREN;
+	}
+
+	if (all and node.state == NODE_EXPANDED and node.count == (std::uint32_t) keep) return;
+
+	std::uint32_t first = (keep > 0 ? Allocate(keep) : 0);
+	if (first == NO_NODES) keep = 0;
+
+	for (int i = 0; i < keep; i++) {
+		MonteCarloNode& c = pool[first + i];
+		InitNode(c, PackTurn(turns[i]));
+
+		for (std::uint32_t j = 0; node.state == NODE_EXPANDED and j < node.count; j++) {
+			MonteCarloNode& o = pool[node.first + j];
+			if (o.turn != c.turn) continue;
+
+			c.visits.store(o.visits.load());
+			c.score.store(o.score.load());
+			c.first = o.first;
+			c.count = o.count;
+			c.state.store(o.state.load());
+			break;
+		}
+	}
+
+	node.first = first;
+	node.count = keep;
+}
+
+// Plays random turns from start and returns the result for white in half points.
+template <int N>
+int MonteCarlo::Playout(const PositionRules<N>& rules, const BasicPosition<N>& start, std::mt19937& rng, std::vector<Turn>& turns) {
+	BasicPosition<N> p = start;
+
+	for (int ply = 0; ply < MCTS_PLAYOUT_PLIES; ply++) {
+		int state = rules.WinState(p);
+		if (state == WINSTATE_WHITE) return 2;
+		if (state == WINSTATE_BLACK) return 0;
+		if (state == WINSTATE_DRAW) return 1;
+
+		turns.clear();
+		rules.possibleTurns(p, turns, 1);
+		if (turns.empty()) break;
+
+		// Half of the time a capture is played if there is one.
+		int captures = CountCaptures(p, turns);
+		int i = (captures > 0 and rng() % 2 == 0 ? rng() % captures : rng() % turns.size());
+		rules.PlayTurn(p, turns[i]);
+	}
+
+	double e;
+	if (network) {
+		Accumulator acc;
+		network->Refresh(p, acc);
+		e = network->Evaluate(acc);
+	} else {
+		e = rules.Evaluate(p, params);
+	}
+
+	return (e > MCTS_ADJUDICATION ? 2 : (e < -MCTS_ADJUDICATION ? 0 : 1));
+}
+
+template <int N>
+void MonteCarlo::Worker(const PositionRules<N>& rules, unsigned seed) {
+	std::mt19937 rng(seed);
+	std::vector<Turn> turns;
+	std::vector<MonteCarloNode*> path;
+	const BasicPosition<N> start = rootPosition.template resize<N>();
+
+	while (!Stop()) {
+		BasicPosition<N> p = start;
+		MonteCarloNode* node = &pool[root];
+		node->visits++;
+		path.clear();
+		path.push_back(node);
+
+		for (;;) {
+			std::uint8_t state = node->state.load(std::memory_order_acquire);
+
+			if (state == NODE_EXPANDED) {
+				if (node->count == 0) break; // decided, or out of nodes
+
+				node = Select(*node);
+				rules.PlayTurn(p, UnpackTurn(node->turn));
+				node->visits++;
+				path.push_back(node);
+				continue;
+			}
+
+			if (state == NODE_LEAF and node->visits >= (std::uint32_t) MCTS_EXPAND_VISITS and node->state.compare_exchange_strong(state, NODE_EXPANDING)) {
+				Expand(*node, rules, p, false, rng, turns);
+				node->state.store(NODE_EXPANDED, std::memory_order_release);
+				continue;
+			}
+
+			break;
+		}
+
+		int white = Playout(rules, p, rng, turns);
+
+		// Every node scores for the side that played into it; sides alternate from the root on.
+		for (unsigned i = 1; i < path.size(); i++) {
+			bool mover = ((start.turn != 0) != ((i - 1) % 2 == 1));
+			path[i]->score += (mover ? white : 2 - white);
+		}
+
+		int depth = path.size() - 1;
+		for (int d = maxDepth; d < depth and !maxDepth.compare_exchange_weak(d, depth);) {
+		}
+
+		playouts++;
+	}
+}
+
+template <int N>
+SearchResult MonteCarlo::Run(Board* board, const PositionRules<N>& rules, int threads, bool verbose) {
+	SearchResult result;
+	result.found = false;
+	result.book = false;
+	result.score = 0.0;
+	result.depth = 0;
+	result.nodes = 0;
+
+	const WidePosition& position = board->getPosition();
+	unsigned long reused = 0;
+
+	if (Reuse(rules, position)) reused = pool[root].visits;
+	else Reset(position);
+
+	// The root lists every turn, even when it used to be a sampled node further down.
+	std::mt19937 rng(SDL_GetTicks());
+	std::vector<Turn> turns;
+	MonteCarloNode& r = pool[root];
+	Expand(r, rules, rootPosition.template resize<N>(), true, rng, turns);
+	r.state = NODE_EXPANDED;
+
+	if (r.count == 0) return result;
+
+	playouts = 0;
+	maxDepth = 0;
+	started = SDL_GetTicks();
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < std::max(threads, 1); i++) {
+		workers.push_back(std::thread(&MonteCarlo::Worker<N>, this, std::cref(rules), (unsigned) rng()));
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	// The most visited turn is the one the search trusts most.
+	const MonteCarloNode* best = &pool[r.first];
+	for (std::uint32_t i = 1; i < r.count; i++) {
+		if (pool[r.first + i].visits > best->visits) best = &pool[r.first + i];
+	}
+
+	double q = (best->visits > 0 ? best->score / (2.0 * best->visits) : 0.5);
+	if (!rootPosition.turn) q = 1.0 - q;
+
+	result.turn = UnpackTurn(best->turn);
+	result.score = 2.0 * q - 1.0;
+	result.depth = maxDepth;
+	result.nodes = playouts;
+	result.found = true;
+
+	if (verbose) {
+		double seconds = 0.001 * std::max(1u, SDL_GetTicks() - started);
+		printf("%lu playouts in %.1f s (%.0f playouts/s) on %d threads, %u nodes, %lu playouts reused.\n", result.nodes, seconds, result.nodes / seconds, std::max(threads, 1), std::min((unsigned) used, MCTS_POOL_NODES), reused);
+	}
+
+	return result;
+}
+
+SearchResult MonteCarlo::Search(Board* board, const Engine& engine) {
+	this->maxPlayouts = engine.maxNodes;
+	this->maxTime = (engine.maxNodes == 0 and engine.maxTime == 0 ? MCTS_DEFAULT_TIME : engine.maxTime);
+	this->beam = engine.beam;
+	this->params = engine.params;
+	this->network = engine.network;
+
+	int w = board->getWidth(), h = board->getHeight();
+
+	switch (BitboardWords(w, h)) {
+		case 1:
+			return Run(board, *PositionRulesFor<1>(w, h), engine.mcts, engine.verbose);
+		case 2:
+			return Run(board, *PositionRulesFor<2>(w, h), engine.mcts, engine.verbose);
+		default:
+			return Run(board, *PositionRulesFor<4>(w, h), engine.mcts, engine.verbose);
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef MCTS_HPP
+#define MCTS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "defines.hpp"
+#include "engine.hpp"
+#include "position.hpp"
+
+class Board;
+
+template <int N>
+class PositionRules;
+
+#define NODE_LEAF 0
+#define NODE_EXPANDING 1
+#define NODE_EXPANDED 2
+
+// A node of the search tree. Its statistics are for the side that played `turn`, and its children
+// are a contiguous range of the node pool.
+struct MonteCarloNode {
+		PackedTurn turn;
+		std::atomic<std::uint32_t> visits; // including playouts that are still running
+		std::atomic<std::uint32_t> score; // in half points: 2 per win, 1 per draw
+		std::uint32_t first, count; // set before state becomes NODE_EXPANDED
+		std::atomic<std::uint8_t> state;
+};
+
+// Monte Carlo tree search (UCT) as an alternative to alpha-beta. All threads share one tree: a
+// playout counts as a loss for every node on its path until its result is in (virtual loss), which
+// spreads the threads over different lines. Playouts pick random turns, with captures preferred, until
+// WinState decides the game or MCTS_PLAYOUT_PLIES have passed, after which the evaluation adjudicates.
+//
+// The root always lists every turn. Deeper nodes keep their captures and a random sample of their
+// other turns, at most MCTS_CHILDREN of them. The tree is kept between searches, so when the next
+// position is a child or grandchild of the last root its subtree is searched further instead of
+// starting over. Repetitions are not taken into account.
+class MonteCarlo {
+	public:
+		MonteCarlo();
+
+		// Uses the budget, evaluation, beam, verbosity and number of threads (mcts) of the engine, but
+		// not its book or tablebases; without a budget it searches for MCTS_DEFAULT_TIME. The score is
+		// the expected result for white, from -1 (black wins) to +1 (white wins), and nodes counts the
+		// playouts.
+		SearchResult Search(Board* board, const Engine& engine);
+
+	protected:
+		std::unique_ptr<MonteCarloNode[]> pool;
+		std::atomic<std::uint32_t> used;
+		std::uint32_t root;
+		WidePosition rootPosition;
+		bool hasTree;
+
+		unsigned long maxPlayouts;
+		unsigned maxTime, started;
+		int beam;
+		EvalParams params;
+		std::shared_ptr<const Network> network;
+
+		std::atomic<unsigned long> playouts;
+		std::atomic<int> maxDepth;
+
+		void Reset(const WidePosition& position);
+		std::uint32_t Allocate(std::uint32_t count);
+		MonteCarloNode* Select(MonteCarloNode& node);
+		bool Stop();
+
+		template <int N>
+		SearchResult Run(Board* board, const PositionRules<N>& rules, int threads, bool verbose);
+		template <int N>
+		bool Reuse(const PositionRules<N>& rules, const WidePosition& position);
+		template <int N>
+		void Expand(MonteCarloNode& node, const PositionRules<N>& rules, const BasicPosition<N>& p, bool all, std::mt19937& rng, std::vector<Turn>& turns);
+		template <int N>
+		int Playout(const PositionRules<N>& rules, const BasicPosition<N>& start, std::mt19937& rng, std::vector<Turn>& turns);
+		template <int N>
+		void Worker(const PositionRules<N>& rules, unsigned seed);
+};
+
+#endif // MCTS_HPP
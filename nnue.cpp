@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "nnue.hpp"
+#include "profile.hpp"
+
+Network::Network() : inputBias(NNUE_HIDDEN, 0), inputWeights(NNUE_FEATURES * NNUE_HIDDEN, 0), hiddenBias(NNUE_HIDDEN2, 0), hidden2Bias(NNUE_HIDDEN3, 0), hiddenWeights(NNUE_HIDDEN2 * NNUE_HIDDEN, 0), hidden2Weights(NNUE_HIDDEN3 * NNUE_HIDDEN2, 0), outputWeights(NNUE_HIDDEN3, 0) {
+	this->outputBias = 0;
+	Fingerprint();
+}
+
+template <typename T>
+static std::uint64_t HashArray(std::uint64_t h, const std::vector<T>& v) {
+	const unsigned char* p = (const unsigned char*) v.data();
+	for (std::size_t i = 0; i < v.size() * sizeof(T); i++) {
+		h = (h ^ p[i]) * 1099511628211ull;
+	}
+
+	return MixHash(h);
+}
+
+void Network::Fingerprint() {
+	std::uint64_t h = 14695981039346656037ull;
+	h = HashArray(h, inputBias);
+	h = HashArray(h, inputWeights);
+	h = HashArray(h, hiddenBias);
+	h = HashArray(h, hiddenWeights);
+	h = HashArray(h, hidden2Bias);
+	h = HashArray(h, hidden2Weights);
+	h = HashArray(h, outputWeights);
+	this->key = MixHash(h ^ (std::uint32_t) outputBias);
+}
+
+template <typename T>
+static bool ReadArray(std::FILE* pFile, std::vector<T>& v) {
+	return std::fread(v.data(), sizeof(T), v.size(), pFile) == v.size();
+}
+
+static NetworkHeader MakeHeader() {
+	NetworkHeader header = { };
+	std::strncpy(header.magic, "SUTNNUE", sizeof(header.magic));
+	header.version = NETWORK_VERSION;
+	header.features = NNUE_FEATURES;
+	header.hidden = NNUE_HIDDEN;
+	header.hidden2 = NNUE_HIDDEN2;
+	header.hidden3 = NNUE_HIDDEN3;
+	return header;
+}
+
+bool Network::Open(std::string filename) {
+	std::FILE* pFile = std::fopen(filename.c_str(), "rb");
+	if (pFile == nullptr) return false;
+
+	NetworkHeader header, expected = MakeHeader();
+	bool ok = std::fread(&header, sizeof(header), 1, pFile) == 1 and std::memcmp(&header, &expected, sizeof(header)) == 0;
+	if (!ok) printf("%s: not a network with %d inputs and layers of %d, %d and %d.\n", filename.c_str(), NNUE_FEATURES, NNUE_HIDDEN, NNUE_HIDDEN2, NNUE_HIDDEN3);
+
+	ok = ok and ReadArray(pFile, inputBias) and ReadArray(pFile, inputWeights);
+	ok = ok and ReadArray(pFile, hiddenBias) and ReadArray(pFile, hiddenWeights);
+	ok = ok and ReadArray(pFile, hidden2Bias) and ReadArray(pFile, hidden2Weights);
+	ok = ok and std::fread(&outputBias, sizeof(outputBias), 1, pFile) == 1 and ReadArray(pFile, outputWeights);
+
+	std::fclose(pFile);
+	Fingerprint();
+	return ok;
+}
+
+// The first layer adds or removes one row of weights per input that changes.
+static inline void AddRow(std::int16_t* v, const std::int16_t* w) {
+#if defined(__AVX2__)
+	for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+		__m256i* p = (__m256i*) (v + i);
+		_mm256_store_si256(p, _mm256_add_epi16(_mm256_load_si256(p), _mm256_loadu_si256((const __m256i*) (w + i))));
+	}
+#elif defined(__SSE2__)
+	for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+		__m128i* p = (__m128i*) (v + i);
+		_mm_store_si128(p, _mm_add_epi16(_mm_load_si128(p), _mm_loadu_si128((const __m128i*) (w + i))));
+	}
+#else
+	for (int i = 0; i < NNUE_HIDDEN; i++) {
+		v[i] += w[i];
+	}
+#endif
+}
+
+static inline void SubRow(std::int16_t* v, const std::int16_t* w) {
+#if defined(__AVX2__)
+	for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+		__m256i* p = (__m256i*) (v + i);
+		_mm256_store_si256(p, _mm256_sub_epi16(_mm256_load_si256(p), _mm256_loadu_si256((const __m256i*) (w + i))));
+	}
+#elif defined(__SSE2__)
+	for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+		__m128i* p = (__m128i*) (v + i);
+		_mm_store_si128(p, _mm_sub_epi16(_mm_load_si128(p), _mm_loadu_si128((const __m128i*) (w + i))));
+	}
+#else
+	for (int i = 0; i < NNUE_HIDDEN; i++) {
+		v[i] -= w[i];
+	}
+#endif
+}
+
+// Clips 16-bit values to 0..127 and narrows them to bytes, n a multiple of 32.
+static inline void Clip(const std::int16_t* v, std::uint8_t* out, int n) {
+#if defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256(), top = _mm256_set1_epi16(127);
+	for (int i = 0; i < n; i += 32) {
+		__m256i a = _mm256_min_epi16(_mm256_max_epi16(_mm256_load_si256((const __m256i*) (v + i)), zero), top);
+		__m256i b = _mm256_min_epi16(_mm256_max_epi16(_mm256_load_si256((const __m256i*) (v + i + 16)), zero), top);
+		// packus works within 128-bit lanes, the permute puts the quarters back in order.
+		_mm256_store_si256((__m256i*) (out + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+	}
+#elif defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128(), top = _mm_set1_epi16(127);
+	for (int i = 0; i < n; i += 16) {
+		__m128i a = _mm_min_epi16(_mm_max_epi16(_mm_load_si128((const __m128i*) (v + i)), zero), top);
+		__m128i b = _mm_min_epi16(_mm_max_epi16(_mm_load_si128((const __m128i*) (v + i + 8)), zero), top);
+		_mm_store_si128((__m128i*) (out + i), _mm_packus_epi16(a, b));
+	}
+#else
+	for (int i = 0; i < n; i++) {
+		out[i] = std::min(std::max((int) v[i], 0), 127);
+	}
+#endif
+}
+
+// Dot product of clipped values and 8-bit weights, n a multiple of 32.
+static inline std::int32_t Dot(const std::uint8_t* a, const std::int8_t* w, int n) {
+#if defined(__AVX2__)
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum = _mm256_setzero_si256();
+	for (int i = 0; i < n; i += 32) {
+		__m256i p = _mm256_maddubs_epi16(_mm256_load_si256((const __m256i*) (a + i)), _mm256_loadu_si256((const __m256i*) (w + i)));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(p, ones));
+	}
+
+	__m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+	return _mm_cvtsi128_si32(s);
+#elif defined(__SSSE3__)
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i sum = _mm_setzero_si128();
+	for (int i = 0; i < n; i += 16) {
+		__m128i p = _mm_maddubs_epi16(_mm_load_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (w + i)));
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(p, ones));
+	}
+
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+	return _mm_cvtsi128_si32(sum);
+#else
+	std::int32_t sum = 0;
+	for (int i = 0; i < n; i++) {
+		sum += a[i] * w[i];
+	}
+	return sum;
+#endif
+}
+
+static inline void Layer(const std::uint8_t* in, int n, const std::int8_t* weights, const std::int32_t* bias, std::uint8_t* out, int m) {
+	for (int j = 0; j < m; j++) {
+		std::int32_t sum = (bias[j] + Dot(in, weights + j * n, n)) >> NNUE_SHIFT;
+		out[j] = std::min(std::max(sum, 0), 127);
+	}
+}
+
+static inline int PieceFeature(int kind, int x, int y) {
+	return (kind * BOARD_MAX_SIZE + y) * BOARD_MAX_SIZE + x;
+}
+
+// Pieces of a kind (white pawn, white knight, black pawn, black knight) in word i.
+template <int N>
+static inline std::uint64_t PieceWord(const BasicPosition<N>& p, int kind, int i) {
+	std::uint64_t side = (kind < 2 ? p.white.w[i] : p.black.w[i]);
+	return side & (kind % 2 ? p.knights.w[i] : ~p.knights.w[i]);
+}
+
+// Reserve and capture counts by kind (0 for reserves, 1 for captures), side and knight.
+template <int N>
+static inline int CountOf(const BasicPosition<N>& p, int index) {
+	int side = (index >> 1) & 1, knight = index & 1;
+	int count = (index < 4 ? p.reserves[side][knight] : p.captures[side][knight]);
+	return std::min(count, NNUE_COUNT_FEATURES);
+}
+
+template <int N>
+void Network::Refresh(const BasicPosition<N>& p, Accumulator& acc) const {
+	std::memcpy(acc.v, inputBias.data(), sizeof(acc.v));
+	const std::int16_t* rows = inputWeights.data();
+
+	for (int kind = 0; kind < 4; kind++) {
+		for (int i = 0; i < N; i++) {
+			for (std::uint64_t b = PieceWord(p, kind, i); b != 0; b &= b - 1) {
+				int sq = 64 * i + __builtin_ctzll(b);
+				AddRow(acc.v, rows + PieceFeature(kind, sq % p.width, sq / p.width) * NNUE_HIDDEN);
+			}
+		}
+	}
+
+	for (int c = 0; c < 8; c++) {
+		for (int k = 0; k < CountOf(p, c); k++) {
+			AddRow(acc.v, rows + (NNUE_COUNT_OFFSET + c * NNUE_COUNT_FEATURES + k) * NNUE_HIDDEN);
+		}
+	}
+
+	if (p.turn) AddRow(acc.v, rows + NNUE_TURN_FEATURE * NNUE_HIDDEN);
+}
+
+template <int N>
+void Network::Update(const BasicPosition<N>& from, const Accumulator& in, const BasicPosition<N>& to, Accumulator& out) const {
+	if (from.width != to.width) {
+		Refresh(to, out);
+		return;
+	}
+
+	out = in;
+	const std::int16_t* rows = inputWeights.data();
+
+	for (int kind = 0; kind < 4; kind++) {
+		for (int i = 0; i < N; i++) {
+			std::uint64_t a = PieceWord(from, kind, i), b = PieceWord(to, kind, i);
+
+			for (std::uint64_t r = a & ~b; r != 0; r &= r - 1) {
+				int sq = 64 * i + __builtin_ctzll(r);
+				SubRow(out.v, rows + PieceFeature(kind, sq % to.width, sq / to.width) * NNUE_HIDDEN);
+			}
+			for (std::uint64_t r = b & ~a; r != 0; r &= r - 1) {
+				int sq = 64 * i + __builtin_ctzll(r);
+				AddRow(out.v, rows + PieceFeature(kind, sq % to.width, sq / to.width) * NNUE_HIDDEN);
+			}
+		}
+	}
+
+	for (int c = 0; c < 8; c++) {
+		const std::int16_t* row = rows + (NNUE_COUNT_OFFSET + c * NNUE_COUNT_FEATURES) * NNUE_HIDDEN;
+		int a = CountOf(from, c), b = CountOf(to, c);
+
+		for (int k = b; k < a; k++) {
+			SubRow(out.v, row + k * NNUE_HIDDEN);
+		}
+		for (int k = a; k < b; k++) {
+			AddRow(out.v, row + k * NNUE_HIDDEN);
+		}
+	}
+
+	if (from.turn and !to.turn) SubRow(out.v, rows + NNUE_TURN_FEATURE * NNUE_HIDDEN);
+	if (to.turn and !from.turn) AddRow(out.v, rows + NNUE_TURN_FEATURE * NNUE_HIDDEN);
+}
+
+double Network::Evaluate(const Accumulator& acc) const {
+	PROFILE_SCOPE(PROFILE_EVALUATE);
+
+	alignas(32) std::uint8_t a[NNUE_HIDDEN], b[NNUE_HIDDEN2], c[NNUE_HIDDEN3];
+
+	Clip(acc.v, a, NNUE_HIDDEN);
+	Layer(a, NNUE_HIDDEN, hiddenWeights.data(), hiddenBias.data(), b, NNUE_HIDDEN2);
+	Layer(b, NNUE_HIDDEN2, hidden2Weights.data(), hidden2Bias.data(), c, NNUE_HIDDEN3);
+
+	return (outputBias + Dot(c, outputWeights.data(), NNUE_HIDDEN3)) / NNUE_OUTPUT_SCALE;
+}
+
+#define NETWORK_WORDS(N) \
+	template void Network::Refresh<N>(const BasicPosition<N>& p, Accumulator& acc) const; \
+	template void Network::Update<N>(const BasicPosition<N>& from, const Accumulator& in, const BasicPosition<N>& to, Accumulator& out) const;
+NETWORK_WORDS(1)
+NETWORK_WORDS(2)
+NETWORK_WORDS(4)
+#undef NETWORK_WORDS
@@ -0,0 +1,76 @@
+#ifndef NNUE_HPP
+#define NNUE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "defines.hpp"
+#include "position.hpp"
+
+// Inputs of the network, all 0 or 1:
+// - a piece of a kind (white pawn, white knight, black pawn, black knight) on tile (x, y), at
+//   (kind * BOARD_MAX_SIZE + y) * BOARD_MAX_SIZE + x, so a network can be used on any board size,
+// - at least k (1..NNUE_COUNT_FEATURES) pieces in the reserves or captured, by side and knight,
+// - white to move.
+const int NNUE_PIECE_FEATURES = 4 * BOARD_MAX_SIZE * BOARD_MAX_SIZE;
+const int NNUE_COUNT_OFFSET = NNUE_PIECE_FEATURES;
+const int NNUE_TURN_FEATURE = NNUE_COUNT_OFFSET + 8 * NNUE_COUNT_FEATURES;
+const int NNUE_FEATURES = NNUE_TURN_FEATURE + 1;
+
+static_assert(NNUE_HIDDEN % 32 == 0 and NNUE_HIDDEN2 % 32 == 0 and NNUE_HIDDEN3 % 32 == 0, "layers are processed 32 values at a time");
+
+// Sums of the first layer for one position. A child's accumulator follows from its parent's by
+// adding and removing the weights of the few inputs a turn changes.
+struct alignas(32) Accumulator {
+		std::int16_t v[NNUE_HIDDEN];
+};
+
+struct NetworkHeader {
+		char magic[8]; // "SUTNNUE"
+		std::uint32_t version;
+		std::uint32_t features, hidden, hidden2, hidden3;
+};
+
+const std::uint32_t NETWORK_VERSION = 1;
+
+// A small quantized network as an alternative to the evaluation in the rules. The first layer
+// (16-bit weights) is kept in an Accumulator; its values are clipped to 0..127 and go through two
+// hidden layers with 8-bit weights, whose 32-bit sums are shifted right by NNUE_SHIFT and clipped
+// the same way, and an output layer whose sum is NNUE_OUTPUT_SCALE per pawn for white.
+//
+// Files hold a NetworkHeader followed by the little-endian layers, each as biases and then weights
+// by output: int16 first layer (by input rather than output), int8/int32 for the others.
+class Network {
+	public:
+		Network();
+
+		bool Open(std::string filename);
+
+		template <int N>
+		void Refresh(const BasicPosition<N>& p, Accumulator& acc) const;
+
+		// Computes the accumulator of `to` from the one of `from`, which should be a position
+		// one turn earlier (any position works, but costs more the more inputs differ).
+		template <int N>
+		void Update(const BasicPosition<N>& from, const Accumulator& in, const BasicPosition<N>& to, Accumulator& out) const;
+
+		// From white's point of view, in the units of PositionRules::Evaluate.
+		double Evaluate(const Accumulator& acc) const;
+
+		// A hash of the weights, the same for the same network in any process.
+		inline std::uint64_t fingerprint() const {
+			return key;
+		}
+
+	protected:
+		std::vector<std::int16_t> inputBias, inputWeights;
+		std::vector<std::int32_t> hiddenBias, hidden2Bias;
+		std::vector<std::int8_t> hiddenWeights, hidden2Weights, outputWeights;
+		std::int32_t outputBias;
+		std::uint64_t key;
+
+		void Fingerprint();
+};
+
+#endif // NNUE_HPP
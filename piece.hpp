@@ -4,6 +4,7 @@
 #include <vector>
 
 class Board;
+class SpriteBatch;
 struct Move;
 
 class Piece {
@@ -17,8 +18,7 @@ class Piece {
 
 		bool isLegalMove(int nx, int ny, bool mayCapture);
 		std::vector<Move> getLegalMoves(bool mayCapture);
-		void Render(SDL_Renderer* context, bool turn);
-		double Evaluate();
+		void Render(SpriteBatch& figures, SpriteBatch& markers, bool capturable);
 
 	protected:
 		Board* board;
@@ -0,0 +1,115 @@
+#ifndef POSITION_HPP
+#define POSITION_HPP
+
+#include <cstdint>
+#include <type_traits>
+
+#include "geometry.hpp"
+#include "profile.hpp"
+
+inline std::uint64_t MixHash(std::uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+// Everything the rules know about a position, as plain data: positions are copied with a memcpy,
+// so they can be stored in tables and handed to other threads as they are. The Position for boards
+// of up to 64 tiles (such as the classical 9x7 board) takes exactly one cache line.
+template <int N>
+struct alignas(N == 1 ? 64 : 8) BasicPosition {
+		Bitboard<N> white, black, knights;
+		std::uint8_t width, height;
+		std::uint8_t turn; // 1 if white is to move
+		std::uint8_t pass; // passes in a row; a new game starts at 2, so the first turn cannot pass
+		std::uint8_t reserves[2][2]; // pieces off the board, by side (1 is white) and knight
+		std::uint8_t captures[2][2]; // pieces captured by each side, by side and knight
+
+		inline int tile(int x, int y) const {
+			return y * width + x;
+		}
+
+		inline bool occupied(int sq) const {
+			return white.test(sq) or black.test(sq);
+		}
+
+		// Only depends on the tiles the board uses, so a position hashes alike at any bitboard size.
+		inline std::uint64_t hash() const {
+			PROFILE_SCOPE(PROFILE_HASH);
+
+			const int words = (width * height + 63) / 64;
+
+			std::uint64_t h = MixHash((std::uint64_t) width | height << 8 | turn << 16 | (std::uint64_t) pass << 24);
+			for (int i = 0; i < 2; i++) {
+				h = MixHash(h ^ (reserves[i][0] | reserves[i][1] << 8 | captures[i][0] << 16 | (std::uint64_t) captures[i][1] << 24));
+			}
+
+			for (int i = 0; i < N and i < words; i++) {
+				h = MixHash(h ^ white.w[i]);
+				h = MixHash(h ^ black.w[i]);
+				h = MixHash(h ^ knights.w[i]);
+			}
+
+			return h;
+		}
+
+		// The position reflected left to right. The rules and the starting position are symmetric, so
+		// it is worth the same.
+		inline BasicPosition mirror() const {
+			BasicPosition p = *this;
+			p.white = { };
+			p.black = { };
+			p.knights = { };
+
+			auto reflect = [this](const Bitboard<N>& from, Bitboard<N>& to) {
+				from.forEach([&](int sq) {
+					to.set(sq + width - 1 - 2 * (sq % width));
+				});
+			};
+
+			reflect(white, p.white);
+			reflect(black, p.black);
+			reflect(knights, p.knights);
+			return p;
+		}
+
+		// The smaller hash of the position and its mirror image, so both share one entry in tables of
+		// positions. Repetitions still need hash(), as a mirror image is not the same position.
+		inline std::uint64_t canonicalHash() const {
+			std::uint64_t h = hash(), m = mirror().hash();
+			return (m < h ? m : h);
+		}
+
+		// The same position with M-word bitboards; M has to hold width * height tiles.
+		template <int M>
+		inline BasicPosition<M> resize() const {
+			BasicPosition<M> p = { };
+			p.white = white.template resize<M>();
+			p.black = black.template resize<M>();
+			p.knights = knights.template resize<M>();
+			p.width = width;
+			p.height = height;
+			p.turn = turn;
+			p.pass = pass;
+
+			for (int i = 0; i < 2; i++) {
+				for (int j = 0; j < 2; j++) {
+					p.reserves[i][j] = reserves[i][j];
+					p.captures[i][j] = captures[i][j];
+				}
+			}
+
+			return p;
+		}
+};
+
+typedef BasicPosition<1> Position;
+typedef BasicPosition<BITBOARD_MAX_WORDS> WidePosition; // any board up to BOARD_MAX_SIZE
+
+static_assert(sizeof(Position) <= 64, "a classical position should fit in a cache line");
+static_assert(std::is_trivial<Position>::value and std::is_standard_layout<Position>::value, "positions should be plain data");
+
+#endif // POSITION_HPP
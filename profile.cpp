@@ -0,0 +1,254 @@
+#include "profile.hpp"
+
+#ifdef PROFILE
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* const SECTION_NAMES[PROFILE_SECTIONS] = {
+	"search",
+	"possibleTurns",
+	"legalMoves",
+	"isLegalMove",
+	"canCapture",
+	"PlayTurn",
+	"WinState",
+	"Evaluate",
+	"hash"
+};
+
+const int PROFILE_MAX_DEPTH = 16; // stacks are keyed by 4 bits per section
+
+static inline std::uint64_t Cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// A hardware counter of this thread, in user space only.
+class PerfCounter {
+	public:
+		PerfCounter() {
+			this->fd = -1;
+			this->page = nullptr;
+		}
+
+		~PerfCounter() {
+#ifdef __linux__
+			if (page != nullptr) munmap((void*) page, sysconf(_SC_PAGESIZE));
+			if (fd >= 0) close(fd);
+#endif
+		}
+
+		bool Open(std::uint64_t config) {
+#ifdef __linux__
+			perf_event_attr attr = { };
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = config;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+
+			fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+			if (fd < 0) return false;
+
+			void* m = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+			if (m != MAP_FAILED) page = (const perf_event_mmap_page*) m;
+			return true;
+#else
+			(void) config;
+			return false;
+#endif
+		}
+
+		inline bool isOpen() const {
+			return fd >= 0;
+		}
+
+		// Reads the counter with rdpmc if the kernel allows it, which avoids a system call.
+		std::uint64_t Read() const {
+#ifdef __linux__
+#if defined(__x86_64__) || defined(__i386__)
+			if (page != nullptr and page->cap_user_rdpmc) {
+				std::uint32_t seq, index;
+				std::uint64_t count;
+
+				do {
+					seq = page->lock;
+					__atomic_signal_fence(__ATOMIC_SEQ_CST);
+					index = page->index;
+					count = page->offset;
+
+					if (index != 0) {
+						int shift = 64 - page->pmc_width;
+						std::int64_t pmc = (std::int64_t) (__rdpmc(index - 1) << shift) >> shift;
+						count += pmc;
+					}
+
+					__atomic_signal_fence(__ATOMIC_SEQ_CST);
+				} while (page->lock != seq);
+
+				if (index != 0) return count;
+			}
+#endif
+			std::uint64_t value = 0;
+			if (fd >= 0 and read(fd, &value, sizeof(value)) != sizeof(value)) value = 0;
+			return value;
+#else
+			return 0;
+#endif
+		}
+
+	protected:
+		int fd;
+#ifdef __linux__
+		const perf_event_mmap_page* page;
+#else
+		const void* page;
+#endif
+};
+
+struct ProfileCounters {
+		std::uint64_t calls, cycles, self, cacheMisses, branchMisses;
+};
+
+struct ProfileFrame {
+		int section;
+		std::uint64_t key; // the sections of the stack, 4 bits each
+		std::uint64_t start, children;
+		std::uint64_t cacheMisses, branchMisses;
+};
+
+struct ProfileThread {
+		ProfileCounters sections[PROFILE_SECTIONS] = { };
+		ProfileFrame frames[PROFILE_MAX_DEPTH];
+		int depth = 0;
+		std::unordered_map<std::uint64_t, std::uint64_t> stacks; // self cycles by stack key
+
+		PerfCounter cacheMisses, branchMisses;
+		bool opened = false;
+};
+
+static thread_local ProfileThread profile;
+static std::mutex foldedLock;
+
+ProfileScope::ProfileScope(int section) {
+	ProfileThread& t = profile;
+
+	if (!t.opened) {
+		t.opened = true;
+#ifdef __linux__
+		t.cacheMisses.Open(PERF_COUNT_HW_CACHE_MISSES);
+		t.branchMisses.Open(PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+	}
+
+	// Sections nested deeper than a stack key holds are timed as part of their parent.
+	if (t.depth >= PROFILE_MAX_DEPTH) {
+		t.depth++;
+		return;
+	}
+
+	ProfileFrame& f = t.frames[t.depth];
+	f.section = section;
+	f.key = (t.depth > 0 ? t.frames[t.depth - 1].key << 4 : 0) | (section + 1);
+	f.children = 0;
+	f.cacheMisses = (t.cacheMisses.isOpen() ? t.cacheMisses.Read() : 0);
+	f.branchMisses = (t.branchMisses.isOpen() ? t.branchMisses.Read() : 0);
+	t.depth++;
+	f.start = Cycles();
+}
+
+ProfileScope::~ProfileScope() {
+	std::uint64_t end = Cycles();
+	ProfileThread& t = profile;
+
+	if (--t.depth >= PROFILE_MAX_DEPTH) return;
+
+	ProfileFrame& f = t.frames[t.depth];
+	ProfileCounters& c = t.sections[f.section];
+	std::uint64_t cycles = end - f.start;
+
+	c.calls++;
+	c.cycles += cycles;
+	c.self += cycles - f.children;
+	if (t.cacheMisses.isOpen()) c.cacheMisses += t.cacheMisses.Read() - f.cacheMisses;
+	if (t.branchMisses.isOpen()) c.branchMisses += t.branchMisses.Read() - f.branchMisses;
+
+	t.stacks[f.key] += cycles - f.children;
+
+	// The parent's own time leaves this call out.
+	if (t.depth > 0) t.frames[t.depth - 1].children += cycles;
+}
+
+void ProfileDump(const char* folded, bool verbose) {
+	ProfileThread& t = profile;
+
+	if (verbose) {
+		std::uint64_t total = 0;
+		for (const ProfileCounters& c : t.sections) {
+			total += c.self;
+		}
+
+		bool counters = t.cacheMisses.isOpen() or t.branchMisses.isOpen();
+		printf("%-14s %12s %12s %8s %7s", "section", "calls", "cycles", "/call", "self");
+		if (counters) printf(" %12s %12s", "cache miss", "branch miss");
+		printf("\n");
+
+		for (int i = 0; i < PROFILE_SECTIONS; i++) {
+			const ProfileCounters& c = t.sections[i];
+			if (c.calls == 0) continue;
+
+			printf("%-14s %12lu %12lu %8.0f %6.1f%%", SECTION_NAMES[i], (unsigned long) c.calls, (unsigned long) c.cycles, (double) c.cycles / c.calls, (total > 0 ? 100.0 * c.self / total : 0.0));
+			if (counters) printf(" %12lu %12lu", (unsigned long) c.cacheMisses, (unsigned long) c.branchMisses);
+			printf("\n");
+		}
+
+		if (!counters) printf("(no hardware counters, perf_event_open is not available)\n");
+	}
+
+	if (folded != nullptr and !t.stacks.empty()) {
+		std::lock_guard<std::mutex> guard(foldedLock);
+		std::FILE* pFile = std::fopen(folded, "a");
+
+		if (pFile != nullptr) {
+			for (const auto& s : t.stacks) {
+				// The key holds the outermost section in its highest non-zero nibble.
+				int sections[PROFILE_MAX_DEPTH], n = 0;
+				for (std::uint64_t k = s.first; k != 0 and n < PROFILE_MAX_DEPTH; k >>= 4) {
+					sections[n++] = (k & 15) - 1;
+				}
+
+				for (int i = n - 1; i >= 0; i--) {
+					std::fprintf(pFile, "%s%s", SECTION_NAMES[sections[i]], (i > 0 ? ";" : ""));
+				}
+				std::fprintf(pFile, " %lu\n", (unsigned long) s.second);
+			}
+
+			std::fclose(pFile);
+		}
+	}
+
+	for (ProfileCounters& c : t.sections) {
+		c = { };
+	}
+	t.stacks.clear();
+}
+
+#endif // PROFILE
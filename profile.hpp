@@ -0,0 +1,48 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+// Scoped instrumentation of the hot paths, compiled in with -DPROFILE (make DEFS=-DPROFILE).
+// Without it PROFILE_SCOPE and PROFILE_DUMP are empty statements.
+//
+// Every section counts calls and time stamp counter cycles, both including nested sections and
+// by themselves, and on Linux the cache misses and mispredicted branches from perf_event_open,
+// read with rdpmc where the kernel allows it. Counters are kept per thread, so a search reports
+// what its own thread did.
+
+#define PROFILE_SEARCH 0
+#define PROFILE_POSSIBLE_TURNS 1
+#define PROFILE_LEGAL_MOVES 2
+#define PROFILE_IS_LEGAL_MOVE 3
+#define PROFILE_CAN_CAPTURE 4
+#define PROFILE_PLAY_TURN 5
+#define PROFILE_WIN_STATE 6
+#define PROFILE_EVALUATE 7
+#define PROFILE_HASH 8
+#define PROFILE_SECTIONS 9
+
+#define PROFILE_FOLDED "profile.folded" // stacks of every search, appended
+
+#ifdef PROFILE
+
+class ProfileScope {
+	public:
+		ProfileScope(int section);
+		~ProfileScope();
+};
+
+// Prints the report of this thread's sections if verbose, appends its stacks to the folded file
+// (one "search;possibleTurns;hash <cycles>" line per stack, as read by flame graph tools) and
+// starts counting over.
+void ProfileDump(const char* folded, bool verbose);
+
+#define PROFILE_SCOPE(section) ProfileScope profileScope(section)
+#define PROFILE_DUMP(folded, verbose) ProfileDump(folded, verbose)
+
+#else
+
+#define PROFILE_SCOPE(section) do { } while (0)
+#define PROFILE_DUMP(folded, verbose) do { } while (0)
+
+#endif // PROFILE
+
+#endif // PROFILE_HPP
@@ -0,0 +1,187 @@
+#include <algorithm>
+
+#include "proof.hpp"
+#include "rules.hpp"
+#include "tablebase.hpp"
+
+ProofSolver::ProofSolver() : abort(false) {
+	this->maxEntries = PROOF_TABLE_ENTRIES;
+	this->attacker = true;
+	this->nodes = 0;
+	this->maxNodes = 0;
+	this->root = 0;
+}
+
+// A key for the positions from the root of the search up to and including the one with hash, never 0.
+static std::uint64_t Extend(std::uint64_t line, std::uint64_t hash) {
+	return MixHash(line ^ hash) | 1;
+}
+
+// Unknown positions start out as needing one more position to prove and one to disprove, and so do
+// positions whose numbers only hold on another line.
+ProofSolver::ProofNumbers ProofSolver::Lookup(std::uint64_t key, std::uint64_t line) const {
+	auto it = table.find(key);
+	if (it != table.end() and (it->second.line == 0 or it->second.line == line)) return it->second;
+	return { 1, 1, 0 };
+}
+
+void ProofSolver::Store(std::uint64_t key, ProofNumbers numbers) {
+	auto it = table.find(key);
+	if (it != table.end()) it->second = numbers;
+	else if (table.size() < maxEntries) table[key] = numbers;
+}
+
+bool ProofSolver::Stop() const {
+	return nodes >= maxNodes or abort.load(std::memory_order_relaxed);
+}
+
+template <int N>
+ProofResult ProofSolver::Prove(const PositionRules<N>& rules, const BasicPosition<N>& position, const std::vector<std::uint64_t>& history, unsigned long maxNodes) {
+	ProofResult result = { };
+	result.result = PROOF_UNKNOWN;
+
+	this->nodes = 0;
+	this->maxNodes = maxNodes;
+	this->attacker = position.turn;
+	this->path = history;
+	this->root = history.size();
+	table.clear();
+
+	if (rules.WinState(position) != WINSTATE_NONE) return result;
+
+	std::uint64_t key = position.canonicalHash(), line = Extend(0, position.hash());
+	Search(rules, position, position.hash(), key, line, PROOF_INFINITY, PROOF_INFINITY);
+
+	ProofNumbers numbers = Lookup(key, line);
+	result.nodes = nodes;
+
+	if (numbers.disproof == 0) result.result = PROOF_NO_WIN;
+	if (numbers.proof != 0) return result;
+
+	// Any child proven to be won will do; they were all won within the same thresholds.
+	std::vector<Turn> turns;
+	rules.possibleTurns(position, turns);
+
+	for (const Turn& t : turns) {
+		BasicPosition<N> child = position;
+		rules.PlayTurn(child, t);
+		std::uint64_t h = child.hash();
+
+		if (std::count(path.begin(), path.end(), h) >= 2) continue;
+
+		ProofNumbers n = Lookup(child.canonicalHash(), Extend(line, h));
+		if (n.proof == 0 and n.disproof != 0) {
+			result.result = PROOF_WIN;
+			result.turn = t;
+			break;
+		}
+	}
+
+	return result;
+}
+
+// Expands a position and keeps searching its most proving child until the position's proof number
+// reaches `proof` or its disproof number reaches `disproof`, which are the thresholds at which a
+// sibling would be more promising.
+template <int N>
+void ProofSolver::Search(const PositionRules<N>& rules, const BasicPosition<N>& position, std::uint64_t hash, std::uint64_t key, std::uint64_t line, std::uint32_t proof, std::uint32_t disproof) {
+	nodes++;
+
+	// Longer lines are not taken to be won, which keeps the recursion in bounds.
+	if (path.size() - root >= PROOF_MAX_PLIES) {
+		Store(key, { PROOF_INFINITY, 0, line });
+		return;
+	}
+
+	std::vector<Turn> turns;
+	rules.possibleTurns(position, turns);
+
+	if (turns.empty()) {
+		Store(key, { PROOF_INFINITY, 0, 0 });
+		return;
+	}
+
+	std::vector<ProofChild<N>> children(turns.size());
+	for (unsigned i = 0; i < turns.size(); i++) {
+		ProofChild<N>& c = children[i];
+		c.position = position;
+		rules.PlayTurn(c.position, turns[i]);
+		c.hash = c.position.hash();
+		std::uint64_t mirrored = c.position.mirror().hash();
+		c.key = (mirrored < c.hash ? mirrored : c.hash);
+		c.line = Extend(line, c.hash);
+
+		if (table.count(c.key) > 0) continue;
+
+		// Decided children are known without being searched.
+		int state = rules.WinState(c.position), value;
+		if (state != WINSTATE_NONE) {
+			bool won = (state == WINSTATE_WHITE and attacker) or (state == WINSTATE_BLACK and !attacker);
+			Store(c.key, won ? ProofNumbers { 0, PROOF_INFINITY, 0 } : ProofNumbers { PROOF_INFINITY, 0, 0 });
+		} else if (tablebase.Probe(c.position, value)) {
+			bool won = (c.position.turn == attacker ? TB_IS_WIN(value) : TB_IS_LOSS(value));
+			Store(c.key, won ? ProofNumbers { 0, PROOF_INFINITY, 0 } : ProofNumbers { PROOF_INFINITY, 0, 0 });
+		}
+	}
+
+	const bool mine = (position.turn == attacker);
+	path.push_back(hash);
+
+	while (true) {
+		// A node of the attacker is as close to proven as its best child and needs every child
+		// disproved, and the other way around for the defender.
+		std::uint64_t sum = 0;
+		std::uint32_t first = PROOF_INFINITY, second = PROOF_INFINITY;
+		unsigned best = 0;
+		ProofNumbers b = { PROOF_INFINITY, 0, 0 };
+		bool repeated = false; // whether a repetition or the end of a line counted below here
+
+		for (unsigned i = 0; i < children.size(); i++) {
+			ProofNumbers n = { PROOF_INFINITY, 0, 0 };
+			if (std::count(path.begin(), path.end(), children[i].hash) < 2) n = Lookup(children[i].key, children[i].line);
+			else repeated = true;
+			repeated = repeated or n.line != 0;
+
+			std::uint32_t minimized = (mine ? n.proof : n.disproof);
+			sum += (mine ? n.disproof : n.proof);
+
+			if (minimized < first) {
+				second = first;
+				first = minimized;
+				best = i;
+				b = n;
+			} else if (minimized < second) {
+				second = minimized;
+			}
+		}
+
+		std::uint32_t summed = (std::uint32_t) std::min<std::uint64_t>(sum, PROOF_INFINITY);
+		ProofNumbers numbers = (mine ? ProofNumbers { first, summed, 0 } : ProofNumbers { summed, first, 0 });
+		if (repeated) numbers.line = line;
+		Store(key, numbers);
+
+		if (numbers.proof >= proof or numbers.disproof >= disproof or Stop()) break;
+
+		// The best child is searched until it is no longer better than the second best, or until
+		// this position reaches its own thresholds.
+		std::uint64_t childProof, childDisproof;
+		if (mine) {
+			childProof = std::min<std::uint64_t>(proof, (std::uint64_t) second + 1);
+			childDisproof = (std::uint64_t) disproof - numbers.disproof + b.disproof;
+		} else {
+			childProof = (std::uint64_t) proof - numbers.proof + b.proof;
+			childDisproof = std::min<std::uint64_t>(disproof, (std::uint64_t) second + 1);
+		}
+
+		Search(rules, children[best].position, children[best].hash, children[best].key, children[best].line, (std::uint32_t) std::min<std::uint64_t>(childProof, PROOF_INFINITY), (std::uint32_t) std::min<std::uint64_t>(childDisproof, PROOF_INFINITY));
+	}
+
+	path.pop_back();
+}
+
+#define PROOF_WORDS(N) \
+	template ProofResult ProofSolver::Prove<N>(const PositionRules<N>& rules, const BasicPosition<N>& position, const std::vector<std::uint64_t>& history, unsigned long maxNodes);
+PROOF_WORDS(1)
+PROOF_WORDS(2)
+PROOF_WORDS(4)
+#undef PROOF_WORDS
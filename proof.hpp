@@ -0,0 +1,75 @@
+#ifndef PROOF_HPP
+#define PROOF_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "defines.hpp"
+#include "position.hpp"
+
+template <int N>
+class PositionRules;
+
+#define PROOF_UNKNOWN 0 // out of nodes
+#define PROOF_WIN 1 // the side to move forces a win
+#define PROOF_NO_WIN 2 // the other side holds at least a draw
+
+struct ProofResult {
+		int result;
+		Turn turn; // the winning turn, if proven
+		unsigned long nodes;
+};
+
+// Depth-first proof-number search (df-pn): whether the side to move can force a win, however long
+// it takes, as far as WinState decides games. Turns of the side to move need one winning child (OR
+// nodes), the other side's turns need every child to be won (AND nodes), and the search always
+// follows the most proving child within thresholds, so it only keeps the current line in memory
+// and remembers proof and disproof numbers in its own table, where mirror images share an entry.
+//
+// Children are checked by WinState as soon as they are generated, so immediate wins and losses are
+// known before they are searched. A position that already occurred twice in the game or in the line
+// leading up to it is a draw, like in the alpha-beta search, and lines longer than PROOF_MAX_PLIES
+// are not won. Both depend on the line rather than the position, so numbers that were worked out
+// with either of them anywhere below are only taken up again on the same line, not in transpositions.
+class ProofSolver {
+	public:
+		ProofSolver();
+
+		// Searches at most maxNodes positions, and stops early once abort is set. The history holds the
+		// hashes of the game so far, for repetitions.
+		template <int N>
+		ProofResult Prove(const PositionRules<N>& rules, const BasicPosition<N>& position, const std::vector<std::uint64_t>& history, unsigned long maxNodes);
+
+		std::atomic<bool> abort;
+		std::size_t maxEntries; // positions kept in the table, new ones are not stored once it is full
+
+	protected:
+		struct ProofNumbers {
+				std::uint32_t proof, disproof;
+				std::uint64_t line; // 0 if they hold on any line, else the line they were found on
+		};
+
+		template <int N>
+		struct ProofChild {
+				BasicPosition<N> position;
+				std::uint64_t hash, key; // key is the canonicalHash() for the table
+				std::uint64_t line; // of the moves from the root to the child, see Extend()
+		};
+
+		template <int N>
+		void Search(const PositionRules<N>& rules, const BasicPosition<N>& position, std::uint64_t hash, std::uint64_t key, std::uint64_t line, std::uint32_t proof, std::uint32_t disproof);
+		ProofNumbers Lookup(std::uint64_t key, std::uint64_t line) const;
+		void Store(std::uint64_t key, ProofNumbers numbers);
+		bool Stop() const;
+
+		std::unordered_map<std::uint64_t, ProofNumbers> table;
+		std::vector<std::uint64_t> path;
+		std::size_t root; // length of the game history at the start of path
+		bool attacker; // the side that tries to win
+		unsigned long nodes, maxNodes;
+};
+
+#endif // PROOF_HPP
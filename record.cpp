@@ -0,0 +1,410 @@
+#include <cstring>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "record.hpp"
+#include "rules.hpp"
+
+RecordWriter::RecordWriter() {
+	this->file = nullptr;
+}
+
+RecordWriter::~RecordWriter() {
+	Close();
+}
+
+bool RecordWriter::Open(std::string filename) {
+	Close();
+
+	file = std::fopen(filename.c_str(), "wb");
+	if (file == nullptr) return false;
+
+	const unsigned char header[12] = { 'S', 'U', 'T', 'R', 'E', 'C', 0, 0, RECORD_VERSION, 0, 0, 0 };
+	buffer.assign(header, header + sizeof(header));
+	return true;
+}
+
+bool RecordWriter::Close() {
+	if (file == nullptr) return true;
+
+	Flush();
+	bool ok = std::ferror(file) == 0;
+	ok = (std::fclose(file) == 0) and ok;
+	file = nullptr;
+	return ok;
+}
+
+void RecordWriter::Flush() {
+	if (file != nullptr and !buffer.empty()) {
+		std::fwrite(buffer.data(), 1, buffer.size(), file);
+	}
+
+	buffer.clear();
+}
+
+void RecordWriter::BeginGame(int width, int height, std::string start) {
+	buffer.push_back('G');
+	buffer.push_back(width);
+	buffer.push_back(height);
+	buffer.push_back(start.empty() ? 0 : 1);
+
+	if (!start.empty()) {
+		buffer.push_back(start.size() & 0xFF);
+		buffer.push_back(start.size() >> 8);
+		buffer.insert(buffer.end(), start.begin(), start.end());
+	}
+}
+
+void RecordWriter::WriteTurn(const Turn& t) {
+	EncodeTurn(t, buffer);
+	if (buffer.size() >= (1 << 16)) Flush();
+}
+
+void RecordWriter::EndGame(int result) {
+	buffer.push_back(0xFF);
+	buffer.push_back(result);
+}
+
+RecordReader::RecordReader() {
+	this->file = nullptr;
+	this->pos = 0;
+	this->len = 0;
+	this->ingame = false;
+	this->result = WINSTATE_NONE;
+}
+
+RecordReader::~RecordReader() {
+	Close();
+}
+
+bool RecordReader::Open(std::string filename) {
+	Close();
+
+	file = std::fopen(filename.c_str(), "rb");
+	if (file == nullptr) return false;
+
+	buffer.resize(1 << 20);
+	pos = 0;
+	len = 0;
+	ingame = false;
+
+	unsigned char header[12];
+	for (int i = 0; i < 12; i++) {
+		int c = get();
+		if (c < 0) {
+			Close();
+			return false;
+		}
+		header[i] = c;
+	}
+
+	if (std::memcmp(header, "SUTREC", 6) != 0 or header[8] != RECORD_VERSION) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void RecordReader::Close() {
+	if (file != nullptr) {
+		std::fclose(file);
+	}
+
+	file = nullptr;
+}
+
+bool RecordReader::Refill() {
+	if (file == nullptr) return false;
+
+	pos = 0;
+	len = std::fread(buffer.data(), 1, buffer.size(), file);
+	return len > 0;
+}
+
+bool RecordReader::NextGame(RecordGame& game) {
+	// Skip whatever is left of the previous game.
+	Turn t;
+	while (ingame and NextTurn(t)) {
+	}
+
+	if (get() != 'G') return false;
+
+	int w = get(), h = get(), flags = get();
+	if (w < 0 or h < 0 or flags < 0) return false;
+
+	game.width = w;
+	game.height = h;
+	game.start = "";
+	game.result = WINSTATE_NONE;
+
+	if (flags & 1) {
+		int lo = get(), hi = get();
+		if (lo < 0 or hi < 0) return false;
+
+		for (int i = 0; i < (lo | hi << 8); i++) {
+			int c = get();
+			if (c < 0) return false;
+			game.start += (char) c;
+		}
+	}
+
+	ingame = true;
+	result = WINSTATE_NONE;
+	return true;
+}
+
+bool RecordReader::NextTurn(Turn& t) {
+	if (!ingame) return false;
+
+	int b = get();
+	if (b == 0xFF or b < 0) {
+		int r = (b < 0 ? -1 : get());
+		ingame = false;
+		result = (r < 0 ? WINSTATE_NONE : r);
+		return false;
+	}
+
+	t.move_count = b & 3;
+	t.flags = (b >> 2) & 7;
+
+	for (int i = 0; i < t.move_count; i++) {
+		int from = get(), to = get();
+
+		// A file cut off inside a ply ends the game there.
+		if (from < 0 or to < 0) {
+			ingame = false;
+			result = WINSTATE_NONE;
+			return false;
+		}
+
+		t.moves[i] = { from & 15, (from >> 4) & 15, to & 15, (to >> 4) & 15 };
+		if (t.flags & TURN_REINFORCE) {
+			t.moves[i].x1 = -1;
+			t.moves[i].y1 = -1;
+		}
+	}
+
+	return true;
+}
+
+void EncodeTurn(const Turn& t, std::vector<unsigned char>& out) {
+	out.push_back((t.move_count & 3) | (t.flags & 7) << 2);
+
+	for (int i = 0; i < t.move_count; i++) {
+		const Move& m = t.moves[i];
+		bool reinforce = t.flags & TURN_REINFORCE;
+		out.push_back(reinforce ? 0 : (m.x1 & 15) | (m.y1 & 15) << 4);
+		out.push_back((m.x2 & 15) | (m.y2 & 15) << 4);
+	}
+}
+
+std::size_t DecodeTurn(const unsigned char* in, Turn& t) {
+	t.move_count = in[0] & 3;
+	t.flags = (in[0] >> 2) & 7;
+
+	for (int i = 0; i < t.move_count; i++) {
+		int from = in[1 + 2 * i], to = in[2 + 2 * i];
+		t.moves[i] = { from & 15, (from >> 4) & 15, to & 15, (to >> 4) & 15 };
+		if (t.flags & TURN_REINFORCE) {
+			t.moves[i].x1 = -1;
+			t.moves[i].y1 = -1;
+		}
+	}
+
+	return 1 + 2 * t.move_count;
+}
+
+std::string TurnString(const Turn& t) {
+	char buf[16];
+
+	if (t.flags & TURN_REINFORCE) {
+		std::snprintf(buf, sizeof(buf), "+%c%d,%d", (t.flags & TURN_REINFORCE_KNIGHT) ? 'K' : 'P', t.moves[0].x2, t.moves[0].y2);
+		return buf;
+	}
+
+	if (t.move_count == 0) return "-";
+
+	std::string s;
+	for (int i = 0; i < t.move_count; i++) {
+		std::snprintf(buf, sizeof(buf), "%d,%d-%d,%d", t.moves[i].x1, t.moves[i].y1, t.moves[i].x2, t.moves[i].y2);
+		if (i > 0) s += ' ';
+		s += buf;
+	}
+
+	return s;
+}
+
+bool ParseTurn(std::string s, Turn& t) {
+	t.move_count = 0;
+	t.flags = TURN_MOVE;
+
+	if (s == "-") return true;
+
+	char kind;
+	int x, y;
+	if (std::sscanf(s.c_str(), "+%c%d,%d", &kind, &x, &y) == 3) {
+		if (kind != 'P' and kind != 'K') return false;
+
+		t.move_count = 1;
+		t.flags = TURN_REINFORCE | (kind == 'K' ? TURN_REINFORCE_KNIGHT : 0);
+		t.moves[0] = { -1, -1, x, y };
+		return true;
+	}
+
+	const char* p = s.c_str();
+	int x1, y1, x2, y2, n;
+	while (t.move_count < 3 and std::sscanf(p, " %d,%d-%d,%d%n", &x1, &y1, &x2, &y2, &n) == 4) {
+		t.moves[(int) t.move_count] = { x1, y1, x2, y2 };
+		t.move_count++;
+		p += n;
+	}
+
+	while (*p == ' ') p++;
+	return t.move_count > 0 and *p == '\0';
+}
+
+bool SetupGame(const RecordGame& game, Board* board) {
+	if (!game.start.empty()) return board->LoadPosition(game.start);
+	if (board->getWidth() != game.width or board->getHeight() != game.height) return false;
+
+	board->NewGame(DEFAULT_PAWNS, DEFAULT_KNIGHTS, DEFAULT_FLANKING);
+	return true;
+}
+
+bool SaveRecord(Board* board, std::string filename) {
+	RecordWriter writer;
+	if (!writer.Open(filename)) return false;
+
+	writer.BeginGame(board->getWidth(), board->getHeight(), board->getStartPosition());
+	for (const Turn& t : board->getTurnHistory()) {
+		writer.WriteTurn(t);
+	}
+	writer.EndGame(board->WinState());
+
+	return writer.Close();
+}
+
+// Finds the turn (or pass) that leads from board to the position with the given summary.
+static bool FindTurn(Board* board, std::string next, Turn& found) {
+	std::vector<Turn> turns = board->possibleTurns();
+
+	Turn pass;
+	pass.move_count = 0;
+	pass.flags = TURN_MOVE;
+	turns.push_back(pass);
+
+	for (Turn t : turns) {
+		Board child(board, t);
+		if (child.summary() == next) {
+			found = t;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ConvertGames(std::string output, std::vector<std::string> inputs) {
+	RecordWriter writer;
+	if (!writer.Open(output)) {
+		printf("Failed to open %s for writing.\n", output.c_str());
+		return false;
+	}
+
+	unsigned long games = 0, plies = 0;
+	for (std::string input : inputs) {
+		std::FILE* pFile = std::fopen(input.c_str(), "r");
+		if (pFile == nullptr) {
+			printf("Failed to open %s.\n", input.c_str());
+			continue;
+		}
+
+		std::vector<std::string> lines;
+		char line[1024];
+		while (std::fgets(line, sizeof(line), pFile) != nullptr) {
+			std::string l(line);
+			while (!l.empty() and (l.back() == '\n' or l.back() == '\r')) {
+				l.pop_back();
+			}
+
+			if (!l.empty()) lines.push_back(l);
+		}
+		std::fclose(pFile);
+
+		if (lines.empty()) continue;
+
+		// Saved games do not contain their first position, try a new game first.
+		Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+		board.NewGame(DEFAULT_PAWNS, DEFAULT_KNIGHTS, DEFAULT_FLANKING);
+
+		Turn t;
+		unsigned first = 0;
+		if (!FindTurn(&board, lines[0], t)) {
+			if (!board.LoadPosition(lines[0])) {
+				printf("%s: cannot read \"%s\".\n", input.c_str(), lines[0].c_str());
+				continue;
+			}
+			first = 1;
+		}
+
+		writer.BeginGame(board.getWidth(), board.getHeight(), board.getStartPosition());
+
+		for (unsigned i = first; i < lines.size(); i++) {
+			if (!FindTurn(&board, lines[i], t)) {
+				printf("%s: no turn leads to line %u, stopping there.\n", input.c_str(), i + 1);
+				break;
+			}
+
+			board.PlayTurn(t);
+			writer.WriteTurn(t);
+			plies++;
+		}
+
+		writer.EndGame(board.WinState());
+		games++;
+	}
+
+	bool ok = writer.Close();
+	printf("Wrote %lu games with %lu plies to %s.\n", games, plies, output.c_str());
+	return ok;
+}
+
+bool ReplayGames(std::string filename) {
+	RecordReader reader;
+	if (!reader.Open(filename)) {
+		printf("%s is not a game archive.\n", filename.c_str());
+		return false;
+	}
+
+	unsigned start = SDL_GetTicks();
+	unsigned long games = 0, plies = 0;
+	int results[4] = { 0, 0, 0, 0 };
+
+	RecordGame game;
+	while (reader.NextGame(game)) {
+		Board board(game.width, game.height);
+		if (!SetupGame(game, &board)) {
+			printf("Game %lu has an unreadable start position.\n", games + 1);
+			continue;
+		}
+
+		// The rules on the plain position, without the history and highlights Board keeps up.
+		const Rules* rules = board.getRules();
+		WidePosition position = board.getPosition();
+
+		Turn t;
+		while (reader.NextTurn(t)) {
+			rules->PlayTurn(position, t);
+			plies++;
+		}
+
+		results[reader.getResult() & 3]++;
+		games++;
+	}
+
+	double seconds = 0.001 * (SDL_GetTicks() - start);
+	printf("Replayed %lu games (%d white wins, %d black wins, %d draws, %d unfinished) with %lu plies in %.2f s (%.0f plies/s).\n", games, results[WINSTATE_WHITE], results[WINSTATE_BLACK], results[WINSTATE_DRAW], results[WINSTATE_NONE], plies, seconds, plies / (seconds > 0.0 ? seconds : 0.001));
+	return true;
+}
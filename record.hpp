@@ -0,0 +1,90 @@
+#ifndef RECORD_HPP
+#define RECORD_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "defines.hpp"
+
+class Board;
+
+// Game archives: an 8-byte "SUTREC" magic and a version, then any number of games. A game is the
+// byte 'G', the board width and height, a flag byte (1 if a summary() start position follows as
+// a 16-bit length and the characters, otherwise the game starts from NewGame), then one record
+// per ply: a byte holding the move count (bits 0-1) and the turn flags (bits 2-4), followed by two
+// bytes per move (x1 | y1 << 4 and x2 | y2 << 4). The byte 0xFF and the WINSTATE_* result end it.
+const unsigned RECORD_VERSION = 1;
+
+struct RecordGame {
+		int width, height;
+		std::string start; // empty for a NewGame start
+		int result; // only valid once NextTurn() returned false
+};
+
+class RecordWriter {
+	public:
+		RecordWriter();
+		~RecordWriter();
+
+		bool Open(std::string filename);
+		bool Close();
+
+		void BeginGame(int width, int height, std::string start);
+		void WriteTurn(const Turn& t);
+		void EndGame(int result);
+
+	protected:
+		std::FILE* file;
+		std::vector<unsigned char> buffer;
+
+		void Flush();
+};
+
+class RecordReader {
+	public:
+		RecordReader();
+		~RecordReader();
+
+		bool Open(std::string filename);
+		void Close();
+
+		bool NextGame(RecordGame& game);
+		bool NextTurn(Turn& t);
+
+		inline int getResult() {
+			return result;
+		}
+
+	protected:
+		std::FILE* file;
+		std::vector<unsigned char> buffer;
+		std::size_t pos, len;
+		bool ingame;
+		int result;
+
+		inline int get() {
+			if (pos == len and !Refill()) return -1;
+			return buffer[pos++];
+		}
+
+		bool Refill();
+};
+
+// One ply record as described above, appended to out; DecodeTurn returns the bytes it read.
+void EncodeTurn(const Turn& t, std::vector<unsigned char>& out);
+std::size_t DecodeTurn(const unsigned char* in, Turn& t);
+
+// Text form of a turn: moves as "x1,y1-x2,y2" separated by spaces, "+P" or "+K" and the target
+// tile for reinforcements and "-" for passing.
+std::string TurnString(const Turn& t);
+bool ParseTurn(std::string s, Turn& t);
+
+// Sets board up at the start of a recorded game.
+bool SetupGame(const RecordGame& game, Board* board);
+
+bool SaveRecord(Board* board, std::string filename);
+bool ConvertGames(std::string output, std::vector<std::string> inputs);
+bool ReplayGames(std::string filename);
+
+#endif // RECORD_HPP
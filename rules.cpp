@@ -0,0 +1,845 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "profile.hpp"
+#include "rules.hpp"
+
+// Evaluate() is a weighted sum of these counts, each white's minus black's.
+#define FEATURE_PAWNS 0
+#define FEATURE_KNIGHTS 1
+#define FEATURE_PAWN_RESERVES 2
+#define FEATURE_KNIGHT_RESERVES 3
+#define FEATURE_PAWN_CAPTURES 4
+#define FEATURE_KNIGHT_CAPTURES 5
+#define FEATURE_CENTER 6
+#define FEATURE_MOBILITY 7
+#define FEATURE_COUNT 8
+
+// Weighs the features of a batch of positions, stored feature by feature (stride values each, a
+// multiple of 4), into their scores.
+static void WeighFeatures(const std::int32_t* features, int stride, const EvalParams& params, double* scores) {
+	const double weights[FEATURE_COUNT] = { params.pawn, params.knight, params.pawn_reserve, params.knight_reserve, params.pawn_capture, params.knight_capture, params.center, params.move };
+
+#if defined(__AVX2__)
+	for (int i = 0; i < stride; i += 4) {
+		__m256d sum = _mm256_setzero_pd();
+		for (int k = 0; k < FEATURE_COUNT; k++) {
+			__m256d f = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*) (features + k * stride + i)));
+			sum = _mm256_add_pd(sum, _mm256_mul_pd(f, _mm256_set1_pd(weights[k])));
+		}
+		_mm256_storeu_pd(scores + i, sum);
+	}
+#elif defined(__SSE2__)
+	for (int i = 0; i < stride; i += 2) {
+		__m128d sum = _mm_setzero_pd();
+		for (int k = 0; k < FEATURE_COUNT; k++) {
+			__m128d f = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*) (features + k * stride + i)));
+			sum = _mm_add_pd(sum, _mm_mul_pd(f, _mm_set1_pd(weights[k])));
+		}
+		_mm_storeu_pd(scores + i, sum);
+	}
+#else
+	for (int i = 0; i < stride; i++) {
+		scores[i] = 0.0;
+		for (int k = 0; k < FEATURE_COUNT; k++) {
+			scores[i] += weights[k] * features[k * stride + i];
+		}
+	}
+#endif
+}
+
+template <class G>
+class RulesKernel: public PositionRules<G::words> {
+	public:
+		static constexpr int N = G::words;
+		typedef BasicPosition<N> P;
+
+		RulesKernel() {
+		}
+
+		RulesKernel(int width, int height) :
+				geometry(width, height) {
+		}
+
+		bool isLegalMove(const P& p, int x, int y, int nx, int ny, bool mayCapture) const override {
+			PROFILE_SCOPE(PROFILE_IS_LEGAL_MOVE);
+
+			if (!inside(x, y) or !inside(nx, ny)) return false;
+
+			int dx = nx - x, dy = ny - y;
+			if (dx < -2 or dx > 2 or dy < -2 or dy > 2) return false;
+
+			int k = STEP_INDEX[dx + 2][dy + 2];
+			if (k < 0) return false;
+
+			int sq = y * geometry.width + x;
+			if (!p.occupied(sq)) return false;
+
+			View v(p, p.white.test(sq));
+			return Legal(v, sq, geometry.tables.steps[sq][k], mayCapture);
+		}
+
+		bool canCapture(const P& p, int x, int y) const override {
+			PROFILE_SCOPE(PROFILE_CAN_CAPTURE);
+
+			if (!inside(x, y)) return false;
+
+			int sq = y * geometry.width + x;
+			if (!p.occupied(sq)) return false;
+
+			View v(p, p.white.test(sq));
+			return Capturable(v.own, v.enemy, sq);
+		}
+
+		int legalMoves(const P& p, int x, int y, bool mayCapture, Move* moves) const override {
+			PROFILE_SCOPE(PROFILE_LEGAL_MOVES);
+
+			if (!inside(x, y)) return 0;
+
+			int sq = y * geometry.width + x;
+			if (!p.occupied(sq)) return 0;
+
+			View v(p, p.white.test(sq));
+			return PieceMoves(v, sq, mayCapture, moves);
+		}
+
+		void possibleTurns(const P& p, std::vector<Turn>& turns, int beam) const override {
+			PROFILE_SCOPE(PROFILE_POSSIBLE_TURNS);
+
+			View v(p, p.turn);
+			Actions(p, turns);
+
+			// Moves: every piece moves on its own, as seen from the current position, to different tiles.
+			std::vector<Move> moves(STEP_COUNT * v.own.count());
+			std::vector<int> first(1, 0);
+			v.own.forEach([&](int sq) {
+				first.push_back(first.back() + PieceMoves(v, sq, false, moves.data() + first.back()));
+			});
+
+			Combine(p.turn, moves, first, beam, turns);
+		}
+
+		void possibleTurns(const P& p, const StepTable<N>& table, std::vector<Turn>& turns, int beam) const override {
+			PROFILE_SCOPE(PROFILE_POSSIBLE_TURNS);
+
+			View v(p, p.turn);
+			const Bitboard<N> occupied = v.own | v.enemy;
+			const int width = geometry.width;
+
+			// Captures and moves are the steps onto enemies and onto empty tiles, in the order of Actions()
+			// and PieceMoves().
+			v.own.forEach([&](int sq) {
+				const Step<N>* steps = geometry.tables.steps[sq];
+				for (unsigned m = table.steps[sq]; m != 0; m &= m - 1) {
+					int to = steps[__builtin_ctz(m)].to;
+					if (!v.enemy.test(to)) continue;
+
+					Turn t;
+					t.move_count = 1;
+					t.moves[0] = { sq % width, sq / width, to % width, to / width };
+					t.flags = TURN_MOVE;
+					turns.push_back(t);
+				}
+			});
+
+			Reinforcements(p, turns);
+
+			std::vector<Move> moves(STEP_COUNT * v.own.count());
+			std::vector<int> first(1, 0);
+			v.own.forEach([&](int sq) {
+				const Step<N>* steps = geometry.tables.steps[sq];
+				int n = first.back();
+				for (unsigned m = table.steps[sq]; m != 0; m &= m - 1) {
+					int to = steps[__builtin_ctz(m)].to;
+					if (!occupied.test(to)) moves[n++] = { sq % width, sq / width, to % width, to / width };
+				}
+				first.push_back(n);
+			});
+
+			Combine(p.turn, moves, first, beam, turns);
+		}
+
+		void singleTurns(const P& p, std::vector<Turn>& turns) const override {
+			PROFILE_SCOPE(PROFILE_POSSIBLE_TURNS);
+
+			View v(p, p.turn);
+			Actions(p, turns);
+
+			Move moves[STEP_COUNT];
+			v.own.forEach([&](int sq) {
+				int n = PieceMoves(v, sq, false, moves);
+				for (int i = 0; i < n; i++) {
+					Turn t;
+					t.move_count = 1;
+					t.moves[0] = moves[i];
+					t.flags = TURN_MOVE;
+					turns.push_back(t);
+				}
+			});
+		}
+
+		bool PlayTurn(P& p, const Turn& t) const override {
+			PROFILE_SCOPE(PROFILE_PLAY_TURN);
+
+			const bool side = p.turn;
+			Bitboard<N>& own = (side ? p.white : p.black);
+			Bitboard<N>& enemy = (side ? p.black : p.white);
+			bool moved = false;
+
+			if (t.flags & TURN_REINFORCE) {
+				bool knight = (t.flags & TURN_REINFORCE_KNIGHT);
+				int sq = p.tile(t.moves[0].x2, t.moves[0].y2);
+
+				own.set(sq);
+				if (knight) p.knights.set(sq);
+				p.reserves[side][knight]--;
+				moved = true;
+			} else {
+				for (int i = 0; i < t.move_count and i < 3; i++) {
+					const Move& m = t.moves[i];
+					int from = p.tile(m.x1, m.y1), to = p.tile(m.x2, m.y2);
+					if (!inside(m.x1, m.y1) or !inside(m.x2, m.y2) or !own.test(from)) continue;
+
+					bool knight = p.knights.test(from);
+					own.reset(from);
+					p.knights.reset(from);
+
+					if (enemy.test(to)) {
+						// Both pieces leave the board: the captured one for good, the other to the reserves.
+						p.reserves[side][knight]++;
+						p.captures[side][p.knights.test(to)]++;
+						enemy.reset(to);
+						p.knights.reset(to);
+					} else {
+						own.set(to);
+						if (knight) p.knights.set(to);
+					}
+
+					moved = true;
+				}
+			}
+
+			if (moved) {
+				p.pass = 0;
+			} else {
+				if (p.pass == 2) return false;
+				p.pass++;
+			}
+
+			p.turn = !p.turn;
+			return true;
+		}
+
+		int WinState(const P& p) const override {
+			PROFILE_SCOPE(PROFILE_WIN_STATE);
+
+			int state = MaterialState(p);
+			if (state != WINSTATE_NONE) return state;
+
+			if (!CanMove(p, true)) return WINSTATE_BLACK;
+			if (!CanMove(p, false)) return WINSTATE_WHITE;
+			return WINSTATE_NONE;
+		}
+
+		int WinState(const P& p, const StepTable<N>& table) const override {
+			PROFILE_SCOPE(PROFILE_WIN_STATE);
+
+			int state = MaterialState(p);
+			if (state != WINSTATE_NONE) return state;
+
+			if (!CanMove(p, table, true)) return WINSTATE_BLACK;
+			if (!CanMove(p, table, false)) return WINSTATE_WHITE;
+			return WINSTATE_NONE;
+		}
+
+		double Evaluate(const P& p, const EvalParams& params) const override {
+			PROFILE_SCOPE(PROFILE_EVALUATE);
+
+			return Score(p, params, [this](const View& v, int sq) {
+				return Mobility(v, sq);
+			});
+		}
+
+		double Evaluate(const P& p, const StepTable<N>& table, const EvalParams& params) const override {
+			PROFILE_SCOPE(PROFILE_EVALUATE);
+
+			return Score(p, params, [&table](const View&, int sq) {
+				return __builtin_popcount(table.steps[sq]);
+			});
+		}
+
+		void legalSteps(const P& p, StepTable<N>& table) const override {
+			PROFILE_SCOPE(PROFILE_LEGAL_MOVES);
+
+			std::fill(table.steps, table.steps + 64 * N, 0);
+			for (int side = 0; side < 2; side++) {
+				View v(p, side);
+				v.own.forEach([&](int sq) {
+					table.steps[sq] = Steps(v, sq);
+				});
+			}
+		}
+
+		void UpdateSteps(const P& parent, const StepTable<N>& from, const P& child, StepTable<N>& table) const override {
+			PROFILE_SCOPE(PROFILE_LEGAL_MOVES);
+
+			if (&from != &table) table = from;
+
+			// Tiles that were emptied have no steps left, pieces near a change get theirs again.
+			const Bitboard<N> changed = Changed(parent, child);
+			changed.forEach([&](int sq) {
+				table.steps[sq] = 0;
+			});
+			(Reach(changed) & (child.white | child.black)).forEach([&](int sq) {
+				table.steps[sq] = Steps(View(child, child.white.test(sq)), sq);
+			});
+		}
+
+		void EvaluateChildren(const P& p, const StepTable<N>& table, const P* children, int count, const EvalParams& params, double* scores) const override {
+			PROFILE_SCOPE(PROFILE_EVALUATE);
+
+			const int stride = (count + 3) & ~3;
+			std::vector<std::int32_t> features(FEATURE_COUNT * stride, 0);
+			std::vector<double> sums(stride);
+			std::vector<int> states(count);
+
+			// The parent's pieces, and the mobility of each of them by tile.
+			const Bitboard<N> occupied = p.white | p.black;
+			std::int32_t base[FEATURE_COUNT] = { };
+			int mobility[64 * N], moving[2] = { 0, 0 };
+
+			occupied.forEach([&](int sq) {
+				mobility[sq] = __builtin_popcount(table.steps[sq]);
+				moving[p.white.test(sq)] += mobility[sq];
+				AddPiece(p, sq, +1, base);
+			});
+
+			for (int i = 0; i < count; i++) {
+				const P& c = children[i];
+
+				// Pieces only need a second look if something changed within their reach.
+				const Bitboard<N> changed = Changed(p, c), dirty = Reach(changed);
+
+				const Bitboard<N> pieces = c.white | c.black;
+				int moves[2] = { moving[0], moving[1] };
+				(dirty & occupied).forEach([&](int sq) {
+					moves[p.white.test(sq)] -= mobility[sq];
+				});
+				(dirty & pieces).forEach([&](int sq) {
+					moves[c.white.test(sq)] += Mobility(View(c, c.white.test(sq)), sq);
+				});
+
+				std::int32_t f[FEATURE_COUNT];
+				std::copy(base, base + FEATURE_COUNT, f);
+				(changed & occupied).forEach([&](int sq) {
+					AddPiece(p, sq, -1, f);
+				});
+				(changed & pieces).forEach([&](int sq) {
+					AddPiece(c, sq, +1, f);
+				});
+
+				f[FEATURE_PAWN_RESERVES] = c.reserves[1][0] - c.reserves[0][0];
+				f[FEATURE_KNIGHT_RESERVES] = c.reserves[1][1] - c.reserves[0][1];
+				f[FEATURE_PAWN_CAPTURES] = c.captures[1][0] - c.captures[0][0];
+				f[FEATURE_KNIGHT_CAPTURES] = c.captures[1][1] - c.captures[0][1];
+				f[FEATURE_MOBILITY] = moves[1] - moves[0];
+
+				for (int k = 0; k < FEATURE_COUNT; k++) {
+					features[k * stride + i] = f[k];
+				}
+
+				// WinState, with the mobility at hand instead of looking for a legal move again.
+				states[i] = MaterialState(c);
+				if (states[i] != WINSTATE_NONE) continue;
+
+				if (moves[1] == 0 and !CanReinforce(c, true)) states[i] = WINSTATE_BLACK;
+				else if (moves[0] == 0 and !CanReinforce(c, false)) states[i] = WINSTATE_WHITE;
+			}
+
+			WeighFeatures(features.data(), stride, params, sums.data());
+
+			for (int i = 0; i < count; i++) {
+				scores[i] = (states[i] == WINSTATE_WHITE ? +1000.0 : (states[i] == WINSTATE_BLACK ? -1000.0 : sums[i]));
+			}
+		}
+
+	protected:
+		G geometry;
+
+		// Index into STEP_DX/STEP_DY by dx + 2 and dy + 2.
+		static constexpr int STEP_INDEX[5][5] = {
+			{ -1, -1, 0, -1, -1 },
+			{ -1, 1, 2, 3, -1 },
+			{ 4, 5, -1, 6, 7 },
+			{ -1, 8, 9, 10, -1 },
+			{ -1, -1, 11, -1, -1 }
+		};
+
+		// The pieces as seen by one side.
+		struct View {
+				View(const P& p, bool side) :
+						own(side ? p.white : p.black), enemy(side ? p.black : p.white), knights(p.knights) {
+				}
+
+				const Bitboard<N>& own;
+				const Bitboard<N>& enemy;
+				const Bitboard<N>& knights;
+		};
+
+		inline bool inside(int x, int y) const {
+			return x >= 0 and y >= 0 and x < geometry.width and y < geometry.height;
+		}
+
+		// A piece can be captured if it has more enemies than allies around it (counting itself).
+		inline bool Capturable(const Bitboard<N>& allies, const Bitboard<N>& enemies, int sq) const {
+			const Bitboard<N>& around = geometry.tables.around[sq];
+			return (around & enemies).count() > (around & allies).count();
+		}
+
+		inline bool Legal(const View& v, int sq, const Step<N>& s, bool mayCapture) const {
+			if (s.to < 0) return false;
+			if (s.knight and not v.knights.test(sq)) return false;
+
+			Bitboard<N> occupied = v.own | v.enemy;
+			if ((occupied & s.path).any()) return false;
+			if ((v.enemy & s.guard).any()) return false;
+
+			if (occupied.test(s.to)) {
+				if (!mayCapture or v.own.test(s.to)) return false;
+				return Capturable(v.enemy, v.own, s.to);
+			}
+
+			return true;
+		}
+
+		inline int PieceMoves(const View& v, int sq, bool mayCapture, Move* moves) const {
+			int n = 0;
+			const int x = sq % geometry.width, y = sq / geometry.width;
+			const Step<N>* steps = geometry.tables.steps[sq];
+
+			Unroll<STEP_COUNT>([&](int k) {
+				if (Legal(v, sq, steps[k], mayCapture)) {
+					moves[n++] = { x, y, steps[k].to % geometry.width, steps[k].to / geometry.width };
+				}
+			});
+
+			return n;
+		}
+
+		// The turns that are a single action: captures, then reinforcements.
+		inline void Actions(const P& p, std::vector<Turn>& turns) const {
+			const int width = geometry.width;
+			View v(p, p.turn);
+
+			// Captures
+			v.own.forEach([&](int sq) {
+				const Step<N>* steps = geometry.tables.steps[sq];
+				Unroll<STEP_COUNT>([&](int k) {
+					if (Legal(v, sq, steps[k], true) and v.enemy.test(steps[k].to)) {
+						Turn t;
+						t.move_count = 1;
+						t.moves[0] = { sq % width, sq / width, steps[k].to % width, steps[k].to / width };
+						t.flags = TURN_MOVE;
+						turns.push_back(t);
+					}
+				});
+			});
+
+			Reinforcements(p, turns);
+		}
+
+		inline void Reinforcements(const P& p, std::vector<Turn>& turns) const {
+			const bool side = p.turn;
+			const int width = geometry.width;
+			const int row = (side ? geometry.height - 1 : 0);
+			for (int i = 0; i < width; i++) {
+				if (p.occupied(row * width + i)) continue;
+
+				if (p.reserves[side][1] > 0) {
+					Turn t;
+					t.move_count = 1;
+					t.moves[0] = { -1, -1, i, row };
+					t.flags = TURN_REINFORCE | TURN_REINFORCE_KNIGHT;
+					turns.push_back(t);
+				}
+				if (p.reserves[side][0] > 0) {
+					Turn t;
+					t.move_count = 1;
+					t.moves[0] = { -1, -1, i, row };
+					t.flags = TURN_REINFORCE;
+					turns.push_back(t);
+				}
+			}
+		}
+
+		// Adds every combination of one to three of the moves to turns, where the moves of the i-th piece
+		// are moves[first[i]] up to moves[first[i + 1]]. With a beam, only the best moves of every piece
+		// are combined into pairs and triples.
+		inline void Combine(bool side, std::vector<Move>& moves, const std::vector<int>& first, int beam, std::vector<Turn>& turns) const {
+			std::vector<int> last(first.begin() + 1, first.end());
+			if (beam > 0) {
+				for (unsigned i = 0; i + 1 < first.size(); i++) {
+					std::stable_sort(moves.begin() + first[i], moves.begin() + first[i + 1], [&](const Move& a, const Move& b) {
+						return MoveScore(a, side) > MoveScore(b, side);
+					});
+					last[i] = MIN(first[i] + beam, first[i + 1]);
+				}
+			}
+
+			for (unsigned i = 0; i + 1 < first.size(); i++) {
+				for (unsigned j = 0; j < i; j++) {
+					for (unsigned k = 0; k < j; k++) {
+						for (int a = first[i]; a < last[i]; a++) {
+							const Move& m = moves[a];
+							for (int b = first[j]; b < last[j]; b++) {
+								const Move& n = moves[b];
+								if (m.x2 == n.x2 and m.y2 == n.y2) continue;
+
+								for (int c = first[k]; c < last[k]; c++) {
+									const Move& l = moves[c];
+									if (m.x2 == l.x2 and m.y2 == l.y2) continue;
+									if (n.x2 == l.x2 and n.y2 == l.y2) continue;
+
+									Turn t;
+									t.move_count = 3;
+									t.moves[0] = m;
+									t.moves[1] = n;
+									t.moves[2] = l;
+									t.flags = TURN_MOVE;
+									turns.push_back(t);
+								}
+							}
+						}
+					}
+
+					for (int a = first[i]; a < last[i]; a++) {
+						const Move& m = moves[a];
+						for (int b = first[j]; b < last[j]; b++) {
+							const Move& n = moves[b];
+							if (m.x2 == n.x2 and m.y2 == n.y2) continue;
+
+							Turn t;
+							t.move_count = 2;
+							t.moves[0] = m;
+							t.moves[1] = n;
+							t.flags = TURN_MOVE;
+							turns.push_back(t);
+						}
+					}
+				}
+
+				for (int a = first[i]; a < first[i + 1]; a++) {
+					Turn t;
+					t.move_count = 1;
+					t.moves[0] = moves[a];
+					t.flags = TURN_MOVE;
+					turns.push_back(t);
+				}
+			}
+		}
+
+		// Cheap rank of a single move for beam generation: towards the centre first, then forward.
+		inline int MoveScore(const Move& m, bool side) const {
+			const int w = geometry.width - 1, h = geometry.height - 1;
+			int centre = MIN(m.x2, w - m.x2) + MIN(m.y2, h - m.y2) - MIN(m.x1, w - m.x1) - MIN(m.y1, h - m.y1);
+			return 2 * centre + (side ? m.y1 - m.y2 : m.y2 - m.y1);
+		}
+
+		// The steps the piece on sq can take, captures included, as in a StepTable.
+		inline std::uint16_t Steps(const View& v, int sq) const {
+			std::uint16_t mask = 0;
+			const Step<N>* steps = geometry.tables.steps[sq];
+			Unroll<STEP_COUNT>([&](int k) {
+				mask |= (std::uint16_t) Legal(v, sq, steps[k], true) << k;
+			});
+			return mask;
+		}
+
+		// The number of tiles the piece on sq can move to, captures included.
+		inline int Mobility(const View& v, int sq) const {
+			return __builtin_popcount(Steps(v, sq));
+		}
+
+		// The tiles on which two positions differ.
+		inline Bitboard<N> Changed(const P& a, const P& b) const {
+			Bitboard<N> changed;
+			for (int w = 0; w < N; w++) {
+				changed.w[w] = (a.white.w[w] ^ b.white.w[w]) | (a.black.w[w] ^ b.black.w[w]) | (a.knights.w[w] ^ b.knights.w[w]);
+			}
+			return changed;
+		}
+
+		// The tiles of the pieces whose moves may change when the given tiles do.
+		inline Bitboard<N> Reach(const Bitboard<N>& changed) const {
+			Bitboard<N> dirty = { };
+			changed.forEach([&](int sq) {
+				dirty = dirty | geometry.tables.reach[sq];
+			});
+			return dirty;
+		}
+
+		// Evaluate(), with the mobility of each piece from mobility(view, sq).
+		template <class F>
+		inline double Score(const P& p, const EvalParams& params, F mobility) const {
+			double score = params.pawn_reserve * (p.reserves[1][0] - p.reserves[0][0]) + params.knight_reserve * (p.reserves[1][1] - p.reserves[0][1]);
+			score += params.pawn_capture * (p.captures[1][0] - p.captures[0][0]) + params.knight_capture * (p.captures[1][1] - p.captures[0][1]);
+
+			for (int side = 0; side < 2; side++) {
+				View v(p, side);
+				double sign = (side ? +1.0 : -1.0);
+
+				v.own.forEach([&](int sq) {
+					double base = (p.knights.test(sq) ? params.knight : params.pawn);
+					score += sign * (base + params.move * mobility(v, sq) + params.center * Center(sq));
+				});
+			}
+
+			return score;
+		}
+
+		inline int Center(int sq) const {
+			int x = sq % geometry.width, y = sq / geometry.width;
+			return MIN(x, geometry.width - 1 - x) + MIN(y, geometry.height - 1 - y);
+		}
+
+		// Counts the piece on sq in the features, or takes it out with sign -1.
+		inline void AddPiece(const P& p, int sq, int sign, std::int32_t* features) const {
+			int s = (p.white.test(sq) ? sign : -sign);
+			features[p.knights.test(sq) ? FEATURE_KNIGHTS : FEATURE_PAWNS] += s;
+			features[FEATURE_CENTER] += s * Center(sq);
+		}
+
+		inline bool CanReinforce(const P& p, bool side) const {
+			if (p.reserves[side][0] == 0 and p.reserves[side][1] == 0) return false;
+
+			const int row = (side ? geometry.height - 1 : 0);
+			for (int i = 0; i < geometry.width; i++) {
+				if (!p.occupied(row * geometry.width + i)) return true;
+			}
+
+			return false;
+		}
+
+		// WinState by the pieces left on the board and in reserve alone.
+		inline int MaterialState(const P& p) const {
+			int white = p.white.count(), black = p.black.count();
+
+			if (white == 0 or white + p.reserves[1][0] + p.reserves[1][1] < 4) return WINSTATE_BLACK;
+			if (black == 0 or black + p.reserves[0][0] + p.reserves[0][1] < 4) return WINSTATE_WHITE;
+			return WINSTATE_NONE;
+		}
+
+		// Whether a side has any turn at all, which is cheaper than listing them.
+		inline bool CanMove(const P& p, bool side) const {
+			if (CanReinforce(p, side)) return true;
+
+			View v(p, side);
+			bool found = false;
+			v.own.forEach([&](int sq) {
+				const Step<N>* steps = geometry.tables.steps[sq];
+				for (int k = 0; k < STEP_COUNT and not found; k++) {
+					found = Legal(v, sq, steps[k], true);
+				}
+			});
+
+			return found;
+		}
+
+		inline bool CanMove(const P& p, const StepTable<N>& table, bool side) const {
+			if (CanReinforce(p, side)) return true;
+
+			bool found = false;
+			(side ? p.white : p.black).forEach([&](int sq) {
+				found = found or table.steps[sq] != 0;
+			});
+
+			return found;
+		}
+};
+
+// Tiles are numbered alike on bitboards of any width, so step tables only differ in length.
+template <int M, int N>
+static void ResizeSteps(const StepTable<M>& from, StepTable<N>& to) {
+	const int tiles = 64 * (M < N ? M : N);
+	std::copy(from.steps, from.steps + tiles, to.steps);
+	std::fill(to.steps + tiles, to.steps + 64 * N, 0);
+}
+
+// Board works on positions of any size; this passes them on to a kernel with narrower bitboards.
+template <int N>
+class WideRules: public Rules {
+	public:
+		WideRules(const PositionRules<N>& rules) :
+				rules(rules) {
+		}
+
+		bool isLegalMove(const WidePosition& p, int x, int y, int nx, int ny, bool mayCapture) const override {
+			return rules.isLegalMove(p.template resize<N>(), x, y, nx, ny, mayCapture);
+		}
+
+		bool canCapture(const WidePosition& p, int x, int y) const override {
+			return rules.canCapture(p.template resize<N>(), x, y);
+		}
+
+		int legalMoves(const WidePosition& p, int x, int y, bool mayCapture, Move* moves) const override {
+			return rules.legalMoves(p.template resize<N>(), x, y, mayCapture, moves);
+		}
+
+		void possibleTurns(const WidePosition& p, std::vector<Turn>& turns, int beam) const override {
+			rules.possibleTurns(p.template resize<N>(), turns, beam);
+		}
+
+		void singleTurns(const WidePosition& p, std::vector<Turn>& turns) const override {
+			rules.singleTurns(p.template resize<N>(), turns);
+		}
+
+		bool PlayTurn(WidePosition& p, const Turn& t) const override {
+			BasicPosition<N> q = p.template resize<N>();
+			if (!rules.PlayTurn(q, t)) return false;
+
+			p = q.template resize<BITBOARD_MAX_WORDS>();
+			return true;
+		}
+
+		int WinState(const WidePosition& p) const override {
+			return rules.WinState(p.template resize<N>());
+		}
+
+		double Evaluate(const WidePosition& p, const EvalParams& params) const override {
+			return rules.Evaluate(p.template resize<N>(), params);
+		}
+
+		void legalSteps(const WidePosition& p, StepTable<BITBOARD_MAX_WORDS>& table) const override {
+			StepTable<N> narrow;
+			rules.legalSteps(p.template resize<N>(), narrow);
+			ResizeSteps(narrow, table);
+		}
+
+		void UpdateSteps(const WidePosition& parent, const StepTable<BITBOARD_MAX_WORDS>& from, const WidePosition& child, StepTable<BITBOARD_MAX_WORDS>& table) const override {
+			StepTable<N> narrow;
+			ResizeSteps(from, narrow);
+			rules.UpdateSteps(parent.template resize<N>(), narrow, child.template resize<N>(), narrow);
+			ResizeSteps(narrow, table);
+		}
+
+		void possibleTurns(const WidePosition& p, const StepTable<BITBOARD_MAX_WORDS>& table, std::vector<Turn>& turns, int beam) const override {
+			StepTable<N> narrow;
+			ResizeSteps(table, narrow);
+			rules.possibleTurns(p.template resize<N>(), narrow, turns, beam);
+		}
+
+		int WinState(const WidePosition& p, const StepTable<BITBOARD_MAX_WORDS>& table) const override {
+			StepTable<N> narrow;
+			ResizeSteps(table, narrow);
+			return rules.WinState(p.template resize<N>(), narrow);
+		}
+
+		double Evaluate(const WidePosition& p, const StepTable<BITBOARD_MAX_WORDS>& table, const EvalParams& params) const override {
+			StepTable<N> narrow;
+			ResizeSteps(table, narrow);
+			return rules.Evaluate(p.template resize<N>(), narrow, params);
+		}
+
+		void EvaluateChildren(const WidePosition& p, const StepTable<BITBOARD_MAX_WORDS>& table, const WidePosition* children, int count, const EvalParams& params, double* scores) const override {
+			StepTable<N> narrow;
+			ResizeSteps(table, narrow);
+
+			std::vector<BasicPosition<N>> positions(count);
+			for (int i = 0; i < count; i++) {
+				positions[i] = children[i].template resize<N>();
+			}
+
+			rules.EvaluateChildren(p.template resize<N>(), narrow, positions.data(), count, params, scores);
+		}
+
+	protected:
+		const PositionRules<N>& rules;
+};
+
+// A kernel together with its view for Board.
+template <class G>
+class KernelSet {
+	public:
+		KernelSet() :
+				wide(kernel) {
+		}
+
+		KernelSet(int width, int height) :
+				kernel(width, height), wide(kernel) {
+		}
+
+		RulesKernel<G> kernel;
+		WideRules<G::words> wide;
+
+		inline const Rules* getRules() const {
+			if constexpr (G::words == BITBOARD_MAX_WORDS) return &kernel;
+			else return &wide;
+		}
+
+		template <int N>
+		inline const PositionRules<N>* getPositionRules() const {
+			if constexpr (G::words == N) return &kernel;
+			else return nullptr;
+		}
+};
+
+#define RULES_KERNEL(W, H) \
+	static const KernelSet<Geometry<W, H>> rules_##W##x##H;
+BOARD_SIZES(RULES_KERNEL)
+#undef RULES_KERNEL
+
+// Generic kernels are shared by all boards of the same size, and live as long as the program.
+template <int N>
+static const KernelSet<DynamicGeometry<N>>* GenericKernel(int width, int height) {
+	static std::mutex lock;
+	static std::map<int, std::unique_ptr<KernelSet<DynamicGeometry<N>>>> kernels;
+
+	std::lock_guard<std::mutex> guard(lock);
+	std::unique_ptr<KernelSet<DynamicGeometry<N>>>& k = kernels[height * BOARD_MAX_SIZE + width];
+	if (!k) k.reset(new KernelSet<DynamicGeometry<N>>(width, height));
+	return k.get();
+}
+
+const Rules* RulesFor(int width, int height) {
+#define RULES_KERNEL(W, H) \
+	if (width == W and height == H) return rules_##W##x##H.getRules();
+	BOARD_SIZES(RULES_KERNEL)
+#undef RULES_KERNEL
+
+	if (width <= 0 or height <= 0 or width > BOARD_MAX_SIZE or height > BOARD_MAX_SIZE) return nullptr;
+
+	switch (BitboardWords(width, height)) {
+		case 1:
+			return GenericKernel<1>(width, height)->getRules();
+		case 2:
+			return GenericKernel<2>(width, height)->getRules();
+		default:
+			return GenericKernel<4>(width, height)->getRules();
+	}
+}
+
+template <int N>
+const PositionRules<N>* PositionRulesFor(int width, int height) {
+#define RULES_KERNEL(W, H) \
+	if (width == W and height == H) return rules_##W##x##H.getPositionRules<N>();
+	BOARD_SIZES(RULES_KERNEL)
+#undef RULES_KERNEL
+
+	if (width <= 0 or height <= 0 or width > BOARD_MAX_SIZE or height > BOARD_MAX_SIZE) return nullptr;
+	if (BitboardWords(width, height) != N) return nullptr;
+
+	return &GenericKernel<N>(width, height)->kernel;
+}
+
+template const PositionRules<1>* PositionRulesFor<1>(int width, int height);
+template const PositionRules<2>* PositionRulesFor<2>(int width, int height);
+template const PositionRules<4>* PositionRulesFor<4>(int width, int height);
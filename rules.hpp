@@ -0,0 +1,81 @@
+#ifndef RULES_HPP
+#define RULES_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "defines.hpp"
+#include "position.hpp"
+
+// The legal steps of every piece of both sides, captures included, by tile: one bit per step, by its
+// index into STEP_DX and STEP_DY (see geometry.hpp), and none for empty tiles. A turn only changes
+// the steps of the pieces near the tiles it changed, so a position's table is best made from the
+// table of the position before with UpdateSteps().
+template <int N>
+struct StepTable {
+		std::uint16_t steps[64 * N];
+};
+
+// The rules of the game for one board size, on positions with N-word bitboards. Every board size
+// gets its own kernel, picked once when the board is created, so the work per move is done with
+// bitboards and (for the sizes in BOARD_SIZES) compile-time dimensions.
+template <int N>
+class PositionRules {
+	public:
+		virtual ~PositionRules() {
+		}
+
+		virtual bool isLegalMove(const BasicPosition<N>& p, int x, int y, int nx, int ny, bool mayCapture) const = 0;
+		virtual bool canCapture(const BasicPosition<N>& p, int x, int y) const = 0;
+
+		// Writes the legal moves of the piece on (x, y) to moves (at most STEP_COUNT) and returns
+		// how many there are.
+		virtual int legalMoves(const BasicPosition<N>& p, int x, int y, bool mayCapture, Move* moves) const = 0;
+
+		// Captures first, then reinforcements, then every combination of one to three moves. With a
+		// beam, pairs and triples are only built from the `beam` best-looking moves of each piece.
+		virtual void possibleTurns(const BasicPosition<N>& p, std::vector<Turn>& turns, int beam = 0) const = 0;
+
+		// Captures, reinforcements and every single move, grouped by piece: the turns that longer
+		// turns are combined from, for searching a turn one move at a time.
+		virtual void singleTurns(const BasicPosition<N>& p, std::vector<Turn>& turns) const = 0;
+
+		// Returns false (and leaves the position alone) if the turn is a pass that is not allowed.
+		virtual bool PlayTurn(BasicPosition<N>& p, const Turn& t) const = 0;
+
+		// Decided by material or by a side that cannot move; repetitions are up to the caller.
+		virtual int WinState(const BasicPosition<N>& p) const = 0;
+
+		// Static evaluation from white's point of view, without noise or checking WinState.
+		virtual double Evaluate(const BasicPosition<N>& p, const EvalParams& params) const = 0;
+
+		// The steps of every piece on p.
+		virtual void legalSteps(const BasicPosition<N>& p, StepTable<N>& table) const = 0;
+
+		// The steps of child, made from those of parent: only the pieces within reach of a tile on
+		// which the two positions differ are looked at again.
+		virtual void UpdateSteps(const BasicPosition<N>& parent, const StepTable<N>& from, const BasicPosition<N>& child, StepTable<N>& table) const = 0;
+
+		// As above, with the steps of p at hand instead of working them out again. The turns come in
+		// the same order.
+		virtual void possibleTurns(const BasicPosition<N>& p, const StepTable<N>& table, std::vector<Turn>& turns, int beam = 0) const = 0;
+		virtual int WinState(const BasicPosition<N>& p, const StepTable<N>& table) const = 0;
+		virtual double Evaluate(const BasicPosition<N>& p, const StepTable<N>& table, const EvalParams& params) const = 0;
+
+		// Scores children that are one turn away from p all at once: +-1000 if WinState decides the
+		// child, its Evaluate() otherwise. Only the pieces near the tiles on which a child differs from
+		// p are looked at again, the rest is taken over from p and its steps.
+		virtual void EvaluateChildren(const BasicPosition<N>& p, const StepTable<N>& table, const BasicPosition<N>* children, int count, const EvalParams& params, double* scores) const = 0;
+};
+
+// Rules on positions of any board size, as used by Board.
+typedef PositionRules<BITBOARD_MAX_WORDS> Rules;
+
+// The kernel for a board size, or nullptr if it is larger than BOARD_MAX_SIZE.
+const Rules* RulesFor(int width, int height);
+
+// The kernel for a board size on its narrowest positions, nullptr unless N == BitboardWords(width, height).
+template <int N>
+const PositionRules<N>* PositionRulesFor(int width, int height);
+
+#endif // RULES_HPP
@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "engine.hpp"
+#include "record.hpp"
+#include "server.hpp"
+#include "transposition.hpp"
+
+// One client. Replies to searches are sent from the worker threads, so writes are serialized.
+struct Connection {
+		int in, out;
+		std::mutex lock;
+
+		~Connection() {
+			if (in > 2) close(in);
+		}
+
+		bool Send(const std::string& line) {
+			std::lock_guard<std::mutex> guard(lock);
+			std::string s = line + '\n';
+
+			for (std::size_t done = 0; done < s.size();) {
+				ssize_t n = write(out, s.data() + done, s.size() - done);
+				if (n <= 0) return false;
+				done += n;
+			}
+
+			return true;
+		}
+};
+
+struct Game {
+		Board board;
+		Engine engine;
+		bool busy, deleted;
+		unsigned long used; // milliseconds of search time so far
+		unsigned long queued; // when the search was asked for, to break ties
+
+		int depth;
+		std::shared_ptr<Connection> client; // of the search
+
+		Game(int width, int height) : board(width, height) {
+			this->busy = false;
+			this->deleted = false;
+			this->used = 0;
+			this->queued = 0;
+			this->depth = 0;
+		}
+};
+
+struct ServerState {
+		std::mutex lock;
+		std::condition_variable ready;
+		std::map<std::string, std::shared_ptr<Game>> games;
+		std::vector<std::pair<std::string, std::shared_ptr<Game>>> queue;
+		int running;
+		unsigned long searches, sequence;
+		std::size_t hashEntries;
+		std::shared_ptr<TranspositionTable> table;
+		bool stop;
+		int listener;
+
+		// Clients on the socket; each one is dropped once its thread is done with it.
+		std::vector<std::shared_ptr<Connection>> connections;
+		int clients;
+		std::condition_variable done;
+};
+
+static void ServerWorker(ServerState& state) {
+	while (true) {
+		std::string name;
+		std::shared_ptr<Game> game;
+		{
+			std::unique_lock<std::mutex> guard(state.lock);
+			state.ready.wait(guard, [&state] {
+				return state.stop or !state.queue.empty();
+			});
+
+			if (state.queue.empty()) return;
+
+			// The game that searched least so far goes first, then the one that asked first.
+			auto next = std::min_element(state.queue.begin(), state.queue.end(), [](const auto& a, const auto& b) {
+				return a.second->used != b.second->used ? a.second->used < b.second->used : a.second->queued < b.second->queued;
+			});
+
+			name = next->first;
+			game = next->second;
+			state.queue.erase(next);
+			state.running++;
+		}
+
+		unsigned start = SDL_GetTicks();
+		SearchResult r = game->engine.Search(&game->board, game->depth);
+		unsigned ms = SDL_GetTicks() - start;
+
+		char buf[128];
+		std::snprintf(buf, sizeof(buf), " %.3f %d %lu %u", r.score, r.depth, r.nodes, ms);
+		std::string reply = name + " bestmove " + (r.found ? TurnString(r.turn) : "none") + buf;
+
+		std::shared_ptr<Connection> client;
+		{
+			std::lock_guard<std::mutex> guard(state.lock);
+			game->used += ms;
+			game->busy = false;
+			state.running--;
+			state.searches++;
+			if (!game->deleted) client = game->client;
+			game->client.reset();
+		}
+
+		if (client) client->Send(reply);
+	}
+}
+
+// Handles one command; returns false once the client is done.
+static bool HandleCommand(ServerState& state, const std::shared_ptr<Connection>& conn, std::string line) {
+	char command[32] = "", name[64] = "";
+	int n = 0;
+	std::sscanf(line.c_str(), " %31s %63s %n", command, name, &n);
+	std::string rest = (n > 0 ? line.substr(n) : "");
+
+	if (std::strcmp(command, "") == 0) return true;
+	if (std::strcmp(command, "quit") == 0) return false;
+
+	std::unique_lock<std::mutex> guard(state.lock);
+
+	if (std::strcmp(command, "shutdown") == 0) {
+		state.stop = true;
+		if (state.listener >= 0) shutdown(state.listener, SHUT_RDWR);
+		state.ready.notify_all();
+		return false;
+	}
+
+	if (std::strcmp(command, "stats") == 0) {
+		char buf[128];
+		std::snprintf(buf, sizeof(buf), "stats %lu %lu %d %lu", state.games.size(), state.queue.size(), state.running, state.searches);
+		guard.unlock();
+		return conn->Send(buf);
+	}
+
+	std::string game = name;
+	if (game.empty()) return conn->Send(std::string("error missing game for ") + command);
+
+	auto it = state.games.find(game);
+	std::shared_ptr<Game> g = (it != state.games.end() ? it->second : nullptr);
+	std::string reply = game + " ok";
+
+	if (std::strcmp(command, "new") == 0) {
+		int width = DEFAULT_WIDTH, height = DEFAULT_HEIGHT;
+		std::sscanf(rest.c_str(), "%d %d", &width, &height);
+
+		if (g) {
+			reply = game + " error exists";
+		} else if (width < 1 or height < 1 or width > BOARD_MAX_SIZE or height > BOARD_MAX_SIZE) {
+			reply = game + " error board size";
+		} else {
+			g = std::make_shared<Game>(width, height);
+			g->board.NewGame(DEFAULT_PAWNS, DEFAULT_KNIGHTS, DEFAULT_FLANKING);
+			g->engine.useBook = false;
+			g->engine.maxHashEntries = state.hashEntries;
+			g->engine.table = state.table;
+			state.games[game] = g;
+		}
+	} else if (!g) {
+		reply = game + " error no such game";
+	} else if (std::strcmp(command, "show") == 0) {
+		reply = game + " position " + g->board.summary();
+	} else if (std::strcmp(command, "delete") == 0) {
+		g->deleted = true;
+		state.games.erase(it);
+		state.queue.erase(std::remove_if(state.queue.begin(), state.queue.end(), [&g](const auto& q) {
+			return q.second == g;
+		}), state.queue.end());
+	} else if (g->busy) {
+		reply = game + " error busy";
+	} else if (std::strcmp(command, "position") == 0) {
+		if (!g->board.LoadPosition(rest)) reply = game + " error position";
+	} else if (std::strcmp(command, "play") == 0) {
+		Turn t;
+		bool legal = false;
+
+		if (ParseTurn(rest, t)) {
+			for (const Turn& u : g->board.possibleTurns()) {
+				legal = legal or SameTurn(t, u);
+			}
+
+			// Passing is never listed, and only refused after two passes in a row.
+			legal = legal or (t.move_count == 0 and g->board.getPosition().pass < 2);
+		}
+
+		if (legal) g->board.PlayTurn(t);
+		else reply = game + " error illegal turn";
+	} else if (std::strcmp(command, "go") == 0) {
+		int depth = 0;
+		unsigned long nodes = 0;
+		unsigned time = 0;
+
+		if (std::sscanf(rest.c_str(), "%d %lu %u", &depth, &nodes, &time) < 1 or depth == 0) {
+			reply = game + " error depth";
+		} else {
+			g->depth = depth;
+			g->engine.maxNodes = nodes;
+			g->engine.maxTime = time;
+			g->busy = true;
+			g->queued = state.sequence++;
+			g->client = conn;
+			state.queue.push_back(std::make_pair(game, g));
+			state.ready.notify_one();
+			return true;
+		}
+	} else {
+		reply = game + " error unknown command " + command;
+	}
+
+	guard.unlock();
+	return conn->Send(reply);
+}
+
+static void ServeConnection(ServerState& state, std::shared_ptr<Connection> conn) {
+	std::string line;
+	char buf[4096];
+	ssize_t n;
+
+	while ((n = read(conn->in, buf, sizeof(buf))) > 0) {
+		for (ssize_t i = 0; i < n; i++) {
+			if (buf[i] != '\n') {
+				if (buf[i] != '\r') line += buf[i];
+				continue;
+			}
+
+			if (!HandleCommand(state, conn, line)) return;
+			line.clear();
+		}
+	}
+}
+
+// Serves a client of the socket and then lets go of it, so its descriptor is closed once no search
+// still has to answer it.
+static void ServeClient(ServerState& state, std::shared_ptr<Connection> conn) {
+	ServeConnection(state, conn);
+
+	std::lock_guard<std::mutex> guard(state.lock);
+	state.connections.erase(std::remove(state.connections.begin(), state.connections.end(), conn), state.connections.end());
+	conn.reset();
+	state.clients--;
+	state.done.notify_all();
+}
+
+bool RunServer(std::string address, int threads, int hashMegabytes, std::string table) {
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	ServerState state;
+	state.running = 0;
+	state.searches = 0;
+	state.sequence = 0;
+	state.hashEntries = (std::size_t) std::max(hashMegabytes, 1) * 1024 * 1024 / HASH_ENTRY_BYTES;
+	state.stop = false;
+	state.listener = -1;
+	state.clients = 0;
+
+	if (!table.empty()) {
+		state.table = std::make_shared<TranspositionTable>();
+		if (!state.table->Open(table, std::max(hashMegabytes, 1))) {
+			printf("Failed to open the transposition table %s.\n", table.c_str());
+			return false;
+		}
+	}
+
+	if (address != "-") {
+		sockaddr_un addr = { };
+		addr.sun_family = AF_UNIX;
+		if (address.size() >= sizeof(addr.sun_path)) {
+			printf("Socket path %s is too long.\n", address.c_str());
+			return false;
+		}
+		std::strcpy(addr.sun_path, address.c_str());
+
+		state.listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(address.c_str());
+		if (state.listener < 0 or bind(state.listener, (sockaddr*) &addr, sizeof(addr)) != 0 or listen(state.listener, 16) != 0) {
+			printf("Failed to listen on %s.\n", address.c_str());
+			if (state.listener >= 0) close(state.listener);
+			return false;
+		}
+
+		if (state.table) printf("Listening on %s with %d threads and a %d MB transposition table in %s shared by all games.\n", address.c_str(), threads, hashMegabytes, table.c_str());
+		else printf("Listening on %s with %d threads and %d MB of hashtable per game.\n", address.c_str(), threads, hashMegabytes);
+	}
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.push_back(std::thread(ServerWorker, std::ref(state)));
+	}
+
+	// A client that went away should not take the server with it.
+	std::signal(SIGPIPE, SIG_IGN);
+
+	if (state.listener < 0) {
+		std::shared_ptr<Connection> conn = std::make_shared<Connection>();
+		conn->in = 0;
+		conn->out = 1;
+		ServeConnection(state, conn);
+	} else {
+		while (true) {
+			int fd = accept(state.listener, nullptr, nullptr);
+
+			if (fd < 0) {
+				{
+					std::lock_guard<std::mutex> guard(state.lock);
+					if (state.stop) break;
+				}
+
+				// A client that gave up before it was accepted, or a signal, changes nothing. Without
+				// descriptors to spare, wait for other clients to leave.
+				if (errno == EINTR or errno == ECONNABORTED) continue;
+				if (errno == EMFILE or errno == ENFILE or errno == ENOBUFS or errno == ENOMEM) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+					continue;
+				}
+
+				printf("Failed to accept a client: %s\n", std::strerror(errno));
+				break;
+			}
+
+			std::shared_ptr<Connection> conn = std::make_shared<Connection>();
+			conn->in = fd;
+			conn->out = fd;
+
+			std::lock_guard<std::mutex> guard(state.lock);
+			state.connections.push_back(conn);
+			state.clients++;
+			std::thread(ServeClient, std::ref(state), conn).detach();
+		}
+	}
+
+	// Without more input (or after a shutdown) the searches asked for so far are finished.
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.stop = true;
+	}
+	state.ready.notify_all();
+
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	if (state.listener >= 0) {
+		// Clients that are still connected are cut off.
+		std::unique_lock<std::mutex> guard(state.lock);
+		for (const std::shared_ptr<Connection>& c : state.connections) {
+			shutdown(c->in, SHUT_RDWR);
+		}
+		state.done.wait(guard, [&state] {
+			return state.clients == 0;
+		});
+		guard.unlock();
+
+		close(state.listener);
+		unlink(address.c_str());
+	}
+
+	return true;
+}
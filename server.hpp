@@ -0,0 +1,30 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <string>
+
+// Hosts any number of games for clients on a Unix socket at `address`, or on standard input and
+// output if it is "-". Searches of all games share `threads` worker threads (all cores if 0), and
+// each game's engine keeps at most `hashMegabytes` of positions in its hashtable. With a `table`
+// file, all games share one transposition table of `hashMegabytes` in total in that file instead,
+// which other servers on the same file share too, and which is still there after a restart. There
+// is no cap per game then: a game that searches a lot fills more of the table, and its entries
+// replace those of other games like any others.
+//
+// The protocol is one command per line, answered by lines that start with the game name:
+//   new <game> [width height]         starts a game (9x7 by default)           -> <game> ok
+//   position <game> <summary>         sets up a position in summary() notation -> <game> ok
+//   play <game> <turn>                plays a turn in TurnString() notation    -> <game> ok
+//   go <game> <depth> [nodes] [time]  searches, answered once the search is done
+//                                     -> <game> bestmove <turn> <score> <depth> <nodes> <ms>
+//   show <game>                                                                -> <game> position <summary>
+//   delete <game>                                                              -> <game> ok
+//   stats                             -> stats <games> <queued> <running> <searches>
+//   quit                              closes the connection
+//   shutdown                          stops the server once the searches asked for are done
+// Errors are answered with "<game> error <reason>". A game takes no other commands than show
+// while it is searching, and games waiting for a search are served in the order of least
+// search time used, so no game can hold up the others.
+bool RunServer(std::string address, int threads, int hashMegabytes, std::string table);
+
+#endif // SERVER_HPP
@@ -0,0 +1,607 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "rules.hpp"
+#include "tablebase.hpp"
+
+Tablebase tablebase;
+
+const std::uint64_t TABLEBASE_MAX_POSITIONS = 1ull << 32;
+
+static std::uint64_t Binomial(int n, int k) {
+	// Saturating table, large enough for every board up to 16x16.
+	static std::uint64_t table[257][17];
+	static bool ready = [] {
+		for (int i = 0; i <= 256; i++) {
+			table[i][0] = 1;
+			for (int j = 1; j <= 16; j++) {
+				if (i == 0) {
+					table[i][j] = 0;
+					continue;
+				}
+
+				std::uint64_t a = table[i - 1][j - 1], b = table[i - 1][j];
+				table[i][j] = (a > UINT64_MAX - b ? UINT64_MAX : a + b);
+			}
+		}
+		return true;
+	}();
+
+	(void) ready;
+	if (n < 0 or k < 0 or k > 16 or n > 256 or k > n) return 0;
+	return table[n][k];
+}
+
+Material MaterialOf(Board* board) {
+	return MaterialOf(board->getPosition());
+}
+
+std::string TablebaseFile(std::string directory, int width, int height, Material m) {
+	char name[64];
+	std::snprintf(name, sizeof(name), "/tb_%dx%d_%d_%d_%d_%d.stb", width, height, m.wp, m.wk, m.bp, m.bk);
+	return directory + name;
+}
+
+TableLayout::TableLayout(int width, int height, Material m) {
+	this->width = width;
+	this->height = height;
+	this->material = m;
+	this->count = 0;
+
+	const int squares = width * height;
+	lookup.assign((m.wp + 1) * (m.wk + 1) * (m.bp + 1) * (m.bk + 1), -1);
+
+	for (int a = 0; a <= m.wp; a++) {
+		for (int b = 0; b <= m.wk; b++) {
+			for (int c = 0; c <= m.bp; c++) {
+				for (int d = 0; d <= m.bk; d++) {
+					// Both sides need a piece on the board, otherwise the game is already decided.
+					if (a + b == 0 or c + d == 0 or a + b + c + d > squares) continue;
+
+					Split s = { { a, b, c, d }, count, 2 };
+					int free = squares;
+					for (int i = 0; i < 4; i++) {
+						s.count *= Binomial(free, s.on[i]);
+						free -= s.on[i];
+					}
+
+					lookup[((a * (m.wk + 1) + b) * (m.bp + 1) + c) * (m.bk + 1) + d] = splits.size();
+					splits.push_back(s);
+					count += s.count;
+				}
+			}
+		}
+	}
+}
+
+int TableLayout::splitOf(const int on[4]) {
+	if (on[0] > material.wp or on[1] > material.wk or on[2] > material.bp or on[3] > material.bk) return -1;
+	return lookup[((on[0] * (material.wk + 1) + on[1]) * (material.bp + 1) + on[2]) * (material.bk + 1) + on[3]];
+}
+
+template <int N>
+bool TableLayout::Index(const BasicPosition<N>& p, std::uint64_t& index) {
+	const int squares = width * height;
+	const Bitboard<N> sides[2] = { p.white, p.black };
+	int on[4] = { 0, 0, 0, 0 };
+	int sq[4][16];
+	bool fits = true;
+
+	// Tiles come out in increasing order, as the ranks below need them.
+	for (int c = 0; c < 4; c++) {
+		sides[c / 2].forEach([&](int t) {
+			if (p.knights.test(t) != (c % 2 == 1)) return;
+			if (on[c] == 16) fits = false;
+			else sq[c][on[c]++] = t;
+		});
+	}
+
+	if (!fits) return false;
+
+	int s = splitOf(on);
+	if (s < 0) return false;
+	if (p.reserves[1][0] != material.wp - on[0] or p.reserves[1][1] != material.wk - on[1]) return false;
+	if (p.reserves[0][0] != material.bp - on[2] or p.reserves[0][1] != material.bk - on[3]) return false;
+
+	// Rank each group of squares among the squares not taken by the groups before it.
+	bool used[256] = { false };
+	std::uint64_t idx = 0;
+	int free = squares;
+
+	for (int c = 0; c < 4; c++) {
+		std::uint64_t r = 0;
+		for (int i = 0; i < on[c]; i++) {
+			int below = 0;
+			for (int q = 0; q < sq[c][i]; q++) {
+				if (used[q]) below++;
+			}
+
+			r += Binomial(sq[c][i] - below, i + 1);
+		}
+
+		for (int i = 0; i < on[c]; i++) {
+			used[sq[c][i]] = true;
+		}
+
+		idx = idx * Binomial(free, on[c]) + r;
+		free -= on[c];
+	}
+
+	index = splits[s].offset + 2 * idx + (p.turn ? 1 : 0);
+	return true;
+}
+
+template <int N>
+void TableLayout::Setup(std::uint64_t index, BasicPosition<N>& p) {
+	const int squares = width * height;
+
+	unsigned s = std::upper_bound(splits.begin(), splits.end(), index, [](std::uint64_t i, const Split& sp) {
+		return i < sp.offset;
+	}) - splits.begin() - 1;
+
+	const Split& sp = splits[s];
+	std::uint64_t idx = index - sp.offset;
+	bool turn = idx & 1;
+	idx >>= 1;
+
+	int free[4];
+	free[0] = squares;
+	for (int c = 1; c < 4; c++) {
+		free[c] = free[c - 1] - sp.on[c - 1];
+	}
+
+	std::uint64_t r[4];
+	for (int c = 3; c >= 0; c--) {
+		std::uint64_t n = Binomial(free[c], sp.on[c]);
+		r[c] = idx % n;
+		idx /= n;
+	}
+
+	p = { };
+	p.width = width;
+	p.height = height;
+	p.turn = turn;
+
+	bool used[256] = { false };
+	for (int c = 0; c < 4; c++) {
+		int rank[16];
+		for (int i = sp.on[c] - 1; i >= 0; i--) {
+			int v = i;
+			while (Binomial(v + 1, i + 1) <= r[c]) v++;
+			r[c] -= Binomial(v, i + 1);
+			rank[i] = v;
+		}
+
+		// Ranks count the squares that were free before this group was placed.
+		int target[16];
+		for (int i = 0; i < sp.on[c]; i++) {
+			int q = 0, seen = -1;
+			for (; q < squares; q++) {
+				if (!used[q] and ++seen == rank[i]) break;
+			}
+
+			target[i] = q;
+		}
+
+		for (int i = 0; i < sp.on[c]; i++) {
+			used[target[i]] = true;
+			(c < 2 ? p.white : p.black).set(target[i]);
+			if (c % 2 == 1) p.knights.set(target[i]);
+		}
+	}
+
+	p.reserves[1][0] = material.wp - sp.on[0];
+	p.reserves[1][1] = material.wk - sp.on[1];
+	p.reserves[0][0] = material.bp - sp.on[2];
+	p.reserves[0][1] = material.bk - sp.on[3];
+}
+
+Tablebase::Tablebase() {
+	this->width = 0;
+	this->height = 0;
+	this->maxPieces = 0;
+}
+
+Tablebase::~Tablebase() {
+	Close();
+}
+
+bool Tablebase::Load(std::string filename) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 or (std::size_t) st.st_size < sizeof(TablebaseHeader)) {
+		close(fd);
+		return false;
+	}
+
+	void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (m == MAP_FAILED) return false;
+
+	const TablebaseHeader* header = (const TablebaseHeader*) m;
+	Material mat = { header->wp, header->wk, header->bp, header->bk };
+	TableLayout* layout = nullptr;
+
+	bool ok = std::memcmp(header->magic, "SUTTB", 6) == 0 and header->version == TABLEBASE_VERSION;
+	ok = ok and (tables.empty() or (header->width == width and header->height == height));
+	ok = ok and sizeof(TablebaseHeader) + header->count <= (std::size_t) st.st_size;
+
+	if (ok) {
+		layout = new TableLayout(header->width, header->height, mat);
+		ok = layout->size() == header->count;
+	}
+
+	if (!ok) {
+		printf("Skipping tablebase %s.\n", filename.c_str());
+		delete layout;
+		munmap(m, st.st_size);
+		return false;
+	}
+
+	Table t = { m, (std::size_t) st.st_size, (const std::uint8_t*) m + sizeof(TablebaseHeader), layout };
+	tables[mat.key()] = t;
+
+	this->width = header->width;
+	this->height = header->height;
+	this->maxPieces = std::max(maxPieces, mat.total());
+
+	return true;
+}
+
+int Tablebase::Open(std::string directory) {
+	DIR* dir = opendir(directory.c_str());
+	if (dir == nullptr) return 0;
+
+	int loaded = 0;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != nullptr) {
+		std::string name = entry->d_name;
+		if (name.size() > 4 and name.compare(name.size() - 4, 4, ".stb") == 0) {
+			if (Load(directory + "/" + name)) loaded++;
+		}
+	}
+
+	closedir(dir);
+	return loaded;
+}
+
+void Tablebase::Close() {
+	for (auto& it : tables) {
+		munmap(it.second.map, it.second.length);
+		delete it.second.layout;
+	}
+
+	tables.clear();
+	this->width = 0;
+	this->height = 0;
+	this->maxPieces = 0;
+}
+
+template <int N>
+bool Tablebase::Probe(const BasicPosition<N>& p, int& value) {
+	if (tables.empty()) return false;
+	if (p.width != width or p.height != height) return false;
+
+	Material m = MaterialOf(p);
+	if (m.total() > maxPieces) return false;
+
+	auto it = tables.find(m.key());
+	if (it == tables.end()) return false;
+
+	std::uint64_t index;
+	if (!it->second.layout->Index(p, index)) return false;
+
+	value = it->second.values[index];
+	return true;
+}
+
+template <int N>
+bool Tablebase::Score(const BasicPosition<N>& p, double& score) {
+	int v;
+	if (!Probe(p, v)) return false;
+
+	double side = (p.turn ? +1.0 : -1.0);
+	if (TB_IS_WIN(v)) score = side * (1000.0 - TB_DISTANCE(v));
+	else if (TB_IS_LOSS(v)) score = -side * (1000.0 - TB_DISTANCE(v));
+	else score = 0.0;
+
+	return true;
+}
+
+bool Tablebase::Probe(Board* board, int& value) {
+	return Probe(board->getPosition(), value);
+}
+
+bool Tablebase::Score(Board* board, double& score) {
+	return Score(board->getPosition(), score);
+}
+
+#define TABLEBASE_WORDS(N) \
+	template bool Tablebase::Probe<N>(const BasicPosition<N>& p, int& value); \
+	template bool Tablebase::Score<N>(const BasicPosition<N>& p, double& score);
+TABLEBASE_WORDS(1)
+TABLEBASE_WORDS(2)
+TABLEBASE_WORDS(4)
+#undef TABLEBASE_WORDS
+
+#define TB_UNKNOWN 0
+#define TB_RESULT_WIN 1
+#define TB_RESULT_LOSS 2
+#define TB_RESULT_MIRRORED 3 // the mirror image has a smaller index and is solved instead
+
+struct TableJob {
+		TableLayout* layout;
+		Material material;
+		std::vector<std::uint8_t> result;
+		std::vector<std::uint16_t> dist;
+};
+
+struct TableUpdate {
+		std::uint64_t index;
+		std::uint8_t result;
+		std::uint16_t dist;
+};
+
+// Value of a child position for its side to move, or TB_UNKNOWN if it is not (yet) known.
+template <int N>
+static int ChildValue(const BasicPosition<N>& child, TableJob& job, int& dist) {
+	Material m = MaterialOf(child);
+	int white = child.white.count(), black = child.black.count();
+
+	// Same order as Board::WinState.
+	int winner = WINSTATE_NONE;
+	if (white == 0 or m.wp + m.wk < 4) winner = WINSTATE_BLACK;
+	else if (black == 0 or m.bp + m.bk < 4) winner = WINSTATE_WHITE;
+
+	if (winner != WINSTATE_NONE) {
+		dist = 0;
+		return ((winner == WINSTATE_WHITE) == (child.turn != 0) ? TB_RESULT_WIN : TB_RESULT_LOSS);
+	}
+
+	if (m.key() == job.material.key()) {
+		std::uint64_t index;
+		if (!job.layout->Index(child, index)) return TB_UNKNOWN;
+		if (job.result[index] == TB_RESULT_MIRRORED and !job.layout->Index(child.mirror(), index)) return TB_UNKNOWN;
+
+		dist = job.dist[index];
+		return job.result[index];
+	}
+
+	int v;
+	if (!tablebase.Probe(child, v)) return TB_UNKNOWN;
+
+	dist = TB_DISTANCE(v);
+	if (TB_IS_WIN(v)) return TB_RESULT_WIN;
+	if (TB_IS_LOSS(v)) return TB_RESULT_LOSS;
+	return TB_UNKNOWN;
+}
+
+// One pass over the unresolved positions. Pass 0 marks the positions WinState already decides, and
+// those whose mirror image comes first, which are the same to the rules and only solved once; pass n
+// finds the wins and losses in exactly n plies from the values of earlier passes.
+template <int N>
+static void SolvePass(TableJob& job, int n, const PositionRules<N>* rules, std::atomic<std::uint64_t>& next, std::vector<TableUpdate>& updates) {
+	const std::uint64_t chunk = 256;
+	std::uint64_t size = job.layout->size();
+	std::uint64_t start;
+	std::vector<Turn> turns;
+
+	while ((start = next.fetch_add(chunk)) < size) {
+		for (std::uint64_t i = start; i < std::min(start + chunk, size); i++) {
+			if (job.result[i] != TB_UNKNOWN) continue;
+
+			BasicPosition<N> position;
+			job.layout->Setup(i, position);
+
+			if (n == 0) {
+				std::uint64_t mirror;
+				if (job.layout->Index(position.mirror(), mirror) and mirror < i) {
+					updates.push_back( { i, TB_RESULT_MIRRORED, 0 });
+					continue;
+				}
+
+				int state = rules->WinState(position);
+				if (state == WINSTATE_WHITE or state == WINSTATE_BLACK) {
+					std::uint8_t r = ((state == WINSTATE_WHITE) == (position.turn != 0) ? TB_RESULT_WIN : TB_RESULT_LOSS);
+					updates.push_back( { i, r, 0 });
+				}
+
+				continue;
+			}
+
+			turns.clear();
+			rules->possibleTurns(position, turns);
+
+			bool win = false, loss = true;
+			for (const Turn& t : turns) {
+				BasicPosition<N> child = position;
+				rules->PlayTurn(child, t);
+				int d = 0;
+				int r = ChildValue(child, job, d);
+
+				if (r == TB_RESULT_LOSS and d <= n - 1) {
+					win = true;
+					break;
+				}
+
+				if (r != TB_RESULT_WIN or d > n - 1) loss = false;
+			}
+
+			if (win) updates.push_back( { i, TB_RESULT_WIN, (std::uint16_t) n });
+			else if (loss) updates.push_back( { i, TB_RESULT_LOSS, (std::uint16_t) n });
+		}
+	}
+}
+
+static bool SolveTable(TableJob& job, int threads, int width, int height, int horizon) {
+	std::uint64_t size = job.layout->size();
+	job.result.assign(size, TB_UNKNOWN);
+	job.dist.assign(size, 0);
+
+	std::uint64_t solved = 0;
+	for (int n = 0;; n++) {
+		std::atomic<std::uint64_t> next(0);
+		std::vector<std::vector<TableUpdate>> updates(threads);
+		std::vector<std::thread> workers;
+
+		for (int i = 0; i < threads; i++) {
+			switch (BitboardWords(width, height)) {
+				case 1:
+					workers.push_back(std::thread(SolvePass<1>, std::ref(job), n, PositionRulesFor<1>(width, height), std::ref(next), std::ref(updates[i])));
+					break;
+				case 2:
+					workers.push_back(std::thread(SolvePass<2>, std::ref(job), n, PositionRulesFor<2>(width, height), std::ref(next), std::ref(updates[i])));
+					break;
+				default:
+					workers.push_back(std::thread(SolvePass<4>, std::ref(job), n, PositionRulesFor<4>(width, height), std::ref(next), std::ref(updates[i])));
+					break;
+			}
+		}
+		for (std::thread& w : workers) {
+			w.join();
+		}
+
+		// Apply after the pass, so every worker saw the same values.
+		std::uint64_t changed = 0;
+		for (std::vector<TableUpdate>& u : updates) {
+			for (TableUpdate& t : u) {
+				job.result[t.index] = t.result;
+				job.dist[t.index] = t.dist;
+			}
+			changed += u.size();
+		}
+
+		solved += changed;
+		printf("  pass %d: %lu positions resolved (%lu/%lu)\n", n, changed, solved, size);
+
+		// Smaller tables can still make positions visible up to their longest distance.
+		if (changed == 0 and n > horizon) break;
+		if (solved == size) break;
+	}
+
+	return true;
+}
+
+bool BuildTablebases(std::string directory, int pieces, int threads, int width, int height) {
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	if (RulesFor(width, height) == nullptr) {
+		printf("Boards can be at most %dx%d.\n", BOARD_MAX_SIZE, BOARD_MAX_SIZE);
+		return false;
+	}
+
+	mkdir(directory.c_str(), 0755);
+
+	tablebase.Close();
+	tablebase.Open(directory);
+	if (!tablebase.tables.empty() and (tablebase.width != width or tablebase.height != height)) {
+		printf("%s contains tables for a %dx%d board.\n", directory.c_str(), tablebase.width, tablebase.height);
+		return false;
+	}
+
+	std::vector<Material> signatures;
+	for (int wp = 0; wp <= DEFAULT_PAWNS; wp++) {
+		for (int wk = 0; wk <= DEFAULT_KNIGHTS; wk++) {
+			for (int bp = 0; bp <= DEFAULT_PAWNS; bp++) {
+				for (int bk = 0; bk <= DEFAULT_KNIGHTS; bk++) {
+					Material m = { wp, wk, bp, bk };
+					if (wp + wk >= 4 and bp + bk >= 4 and m.total() <= pieces) signatures.push_back(m);
+				}
+			}
+		}
+	}
+
+	std::stable_sort(signatures.begin(), signatures.end(), [](const Material& a, const Material& b) {
+		return a.total() < b.total();
+	});
+
+	unsigned start = SDL_GetTicks();
+
+	for (Material m : signatures) {
+		if (tablebase.tables.count(m.key()) > 0) continue;
+
+		TableJob job;
+		job.layout = new TableLayout(width, height, m);
+		job.material = m;
+
+		printf("Solving %d/%d pawns and %d/%d knights: %lu positions.\n", m.wp, m.bp, m.wk, m.bk, job.layout->size());
+		if (job.layout->size() > TABLEBASE_MAX_POSITIONS) {
+			printf("Table is too large, stopping here.\n");
+			delete job.layout;
+			return false;
+		}
+
+		int horizon = 0;
+		for (auto& it : tablebase.tables) {
+			for (std::uint64_t i = 0; i < it.second.layout->size(); i++) {
+				horizon = std::max(horizon, TB_DISTANCE(it.second.values[i]) + 1);
+			}
+		}
+
+		SolveTable(job, threads, width, height, horizon);
+
+		std::string filename = TablebaseFile(directory, width, height, m);
+		std::FILE* pFile = std::fopen(filename.c_str(), "wb");
+		if (pFile == nullptr) {
+			printf("Failed to open %s for writing.\n", filename.c_str());
+			delete job.layout;
+			return false;
+		}
+
+		TablebaseHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "SUTTB", 6);
+		header.version = TABLEBASE_VERSION;
+		header.width = width;
+		header.height = height;
+		header.wp = m.wp;
+		header.wk = m.wk;
+		header.bp = m.bp;
+		header.bk = m.bk;
+		header.count = job.layout->size();
+
+		// Mirror images are written out in full, so probing needs no reflection.
+		std::vector<std::uint8_t> values(job.layout->size());
+		for (std::uint64_t i = 0; i < values.size(); i++) {
+			std::uint64_t j = i;
+			if (job.result[i] == TB_RESULT_MIRRORED) {
+				WidePosition p;
+				job.layout->Setup(i, p);
+				job.layout->Index(p.mirror(), j);
+			}
+
+			if (job.result[j] == TB_RESULT_WIN) values[i] = TB_WIN(job.dist[j]);
+			else if (job.result[j] == TB_RESULT_LOSS) values[i] = TB_LOSS(job.dist[j]);
+			else values[i] = TB_DRAW;
+		}
+
+		bool ok = std::fwrite(&header, sizeof(header), 1, pFile) == 1;
+		ok = ok and std::fwrite(values.data(), 1, values.size(), pFile) == values.size();
+		ok = (std::fclose(pFile) == 0) and ok;
+		delete job.layout;
+
+		if (!ok or !tablebase.Load(filename)) {
+			printf("Failed to write %s.\n", filename.c_str());
+			return false;
+		}
+
+		printf("Wrote %s, %.1f s elapsed.\n", filename.c_str(), 0.001 * (SDL_GetTicks() - start));
+	}
+
+	return true;
+}
@@ -0,0 +1,130 @@
+#ifndef TABLEBASE_HPP
+#define TABLEBASE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "position.hpp"
+
+class Board;
+
+// Total material of both sides (on the board plus in reserves). Captures are the only turns that
+// change it, so every table only depends on itself and on tables with fewer pieces.
+struct Material {
+		int wp, wk, bp, bk;
+
+		inline int total() const {
+			return wp + wk + bp + bk;
+		}
+
+		inline int key() const {
+			return ((wp * 32 + wk) * 32 + bp) * 32 + bk;
+		}
+};
+
+// Values are stored as one byte per position, from the point of view of the side to move:
+// 0 is a draw, 1..127 a win in (value - 1) plies and 128..255 a loss in (value - 128) plies.
+// Distances that do not fit are saturated, which keeps the result but not the exact distance.
+#define TB_DRAW 0
+#define TB_WIN(d) ((d) < 126 ? 1 + (d) : 127)
+#define TB_LOSS(d) ((d) < 127 ? 128 + (d) : 255)
+#define TB_IS_WIN(v) ((v) >= 1 and (v) <= 127)
+#define TB_IS_LOSS(v) ((v) >= 128)
+#define TB_DISTANCE(v) (TB_IS_LOSS(v) ? (v) - 128 : (v) - 1)
+
+struct TablebaseHeader {
+		char magic[8]; // "SUTTB"
+		std::uint32_t version;
+		std::uint16_t width, height;
+		std::uint8_t wp, wk, bp, bk;
+		std::uint32_t reserved;
+		std::uint64_t count;
+};
+
+const std::uint32_t TABLEBASE_VERSION = 1;
+
+// Maps positions of one material signature to dense indices: first by how many pieces of each
+// kind are on the board, then by the combinatorial rank of their squares and the side to move.
+class TableLayout {
+	public:
+		TableLayout(int width, int height, Material m);
+
+		template <int N>
+		bool Index(const BasicPosition<N>& p, std::uint64_t& index);
+		template <int N>
+		void Setup(std::uint64_t index, BasicPosition<N>& p);
+
+		inline std::uint64_t size() {
+			return count;
+		}
+
+	protected:
+		struct Split {
+				int on[4]; // white pawns, white knights, black pawns, black knights on the board
+				std::uint64_t offset, count;
+		};
+
+		int width, height;
+		Material material;
+		std::vector<Split> splits;
+		std::vector<int> lookup;
+		std::uint64_t count;
+
+		int splitOf(const int on[4]);
+};
+
+class Tablebase {
+	public:
+		Tablebase();
+		~Tablebase();
+
+		int Open(std::string directory);
+		void Close();
+
+		template <int N>
+		bool Probe(const BasicPosition<N>& p, int& value);
+		template <int N>
+		bool Score(const BasicPosition<N>& p, double& score);
+
+		bool Probe(Board* board, int& value);
+		bool Score(Board* board, double& score);
+
+		inline int getMaxPieces() {
+			return maxPieces;
+		}
+
+	protected:
+		struct Table {
+				void* map;
+				std::size_t length;
+				const std::uint8_t* values;
+				TableLayout* layout;
+		};
+
+		std::map<int, Table> tables;
+		int width, height, maxPieces;
+
+		friend bool BuildTablebases(std::string directory, int pieces, int threads, int width, int height);
+		bool Load(std::string filename);
+};
+
+extern Tablebase tablebase;
+
+template <int N>
+inline Material MaterialOf(const BasicPosition<N>& p) {
+	int wk = (p.white & p.knights).count(), bk = (p.black & p.knights).count();
+	Material m = { p.reserves[1][0] + p.white.count() - wk, p.reserves[1][1] + wk, p.reserves[0][0] + p.black.count() - bk, p.reserves[0][1] + bk };
+	return m;
+}
+
+Material MaterialOf(Board* board);
+std::string TablebaseFile(std::string directory, int width, int height, Material m);
+
+// Generates every table with at most `pieces` pieces in total that is not already present in
+// `directory`, smallest first, using `threads` threads.
+bool BuildTablebases(std::string directory, int pieces, int threads, int width, int height);
+
+#endif // TABLEBASE_HPP
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "engine.hpp"
+#include "record.hpp"
+#include "tactics.hpp"
+
+struct TacticsPosition {
+		std::string name, position;
+		std::vector<Turn> solutions;
+};
+
+static bool ReadSuite(std::string filename, std::vector<TacticsPosition>& positions) {
+	std::FILE* pFile = std::fopen(filename.c_str(), "r");
+	if (pFile == nullptr) {
+		printf("Failed to open %s.\n", filename.c_str());
+		return false;
+	}
+
+	char buf[1024];
+	int line = 0;
+	bool ok = true;
+
+	while (std::fgets(buf, sizeof(buf), pFile) != nullptr) {
+		line++;
+
+		std::string l(buf);
+		while (!l.empty() and (l.back() == '\n' or l.back() == '\r')) {
+			l.pop_back();
+		}
+
+		if (l.empty() or l[0] == '#') continue;
+
+		std::vector<std::string> fields;
+		for (std::size_t start = 0, tab; start <= l.size(); start = tab + 1) {
+			tab = l.find('\t', start);
+			if (tab == std::string::npos) tab = l.size();
+			fields.push_back(l.substr(start, tab - start));
+		}
+
+		TacticsPosition t;
+		Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+		bool valid = fields.size() >= 3 and board.LoadPosition(fields[1]);
+
+		if (valid) {
+			t.name = fields[0];
+			t.position = fields[1];
+			std::vector<Turn> turns = board.possibleTurns();
+
+			// Every solution has to be a legal turn, or the position could never be solved.
+			for (std::size_t i = 2; i < fields.size() and valid; i++) {
+				Turn s;
+				valid = ParseTurn(fields[i], s) and std::any_of(turns.begin(), turns.end(), [&s](const Turn& u) {
+					return SameTurn(s, u);
+				});
+				t.solutions.push_back(s);
+			}
+		}
+
+		if (valid) {
+			positions.push_back(t);
+		} else {
+			printf("%s:%d: cannot read \"%s\".\n", filename.c_str(), line, l.c_str());
+			ok = false;
+		}
+	}
+
+	std::fclose(pFile);
+	return ok;
+}
+
+bool RunTactics(std::string suite, const EngineConfig& config) {
+	std::vector<TacticsPosition> positions;
+	if (!ReadSuite(suite, positions)) return false;
+
+	int solved = 0;
+	unsigned long total = 0;
+
+	for (const TacticsPosition& t : positions) {
+		auto solves = [&t](const Turn& turn) {
+			return std::any_of(t.solutions.begin(), t.solutions.end(), [&turn](const Turn& s) {
+				return SameTurn(s, turn);
+			});
+		};
+
+		Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+		board.LoadPosition(t.position);
+
+		// The noise between equal turns would only blur the times.
+		Engine engine;
+		ConfigureEngine(engine, config);
+		engine.params.dispersion = 0.0;
+
+		unsigned start = SDL_GetTicks();
+		SearchResult r = engine.Search(&board, config.depth);
+		unsigned elapsed = SDL_GetTicks() - start, found = elapsed;
+
+		bool ok = r.found and solves(r.turn);
+		if (ok) {
+			// Back from the last finished depth, for as long as the engine had a solution.
+			for (auto it = engine.iterations.rbegin(); it != engine.iterations.rend() and solves(it->first.turn); it++) {
+				found = it->second;
+			}
+
+			solved++;
+		}
+
+		total += found;
+		printf("%-24s %-6s %7u ms  depth %2d  %s\n", t.name.c_str(), (ok ? "solved" : "failed"), found, r.depth, (r.found ? TurnString(r.turn).c_str() : "none"));
+	}
+
+	printf("Solved %d of %lu positions in %.1f seconds.\n", solved, positions.size(), 0.001 * total);
+	return true;
+}
@@ -0,0 +1,18 @@
+#ifndef TACTICS_HPP
+#define TACTICS_HPP
+
+#include <string>
+
+#include "match.hpp"
+
+// Tactical suites are text files with one position per line: a name, the position in summary()
+// notation and every turn that solves it, separated by tabs. Empty lines and lines starting with
+// '#' are skipped.
+//
+// Searches every position with a fresh engine and prints whether it played a solution, and how long
+// it took to find it: the time of the first finished depth from which on the engine's best turn was
+// a solution. Positions that are not solved count with the whole time of their search in the total,
+// so the total goes down as the engine finds solutions sooner or finds more of them.
+bool RunTactics(std::string suite, const EngineConfig& config);
+
+#endif // TACTICS_HPP
@@ -0,0 +1,166 @@
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "transposition.hpp"
+
+const std::uint64_t ENTRY_USED = 1ull << 63; // so an empty entry never matches key 0
+
+static inline std::uint64_t Pack(const TableValue& v, std::uint8_t generation) {
+	std::uint32_t score;
+	std::memcpy(&score, &v.score, sizeof(score));
+
+	int depth = (v.depth < 0 ? 0 : (v.depth > 255 ? 255 : v.depth));
+	return ENTRY_USED | (std::uint64_t) generation << 48 | (std::uint64_t) v.bound << 40 | (std::uint64_t) depth << 32 | score;
+}
+
+static inline TableValue Unpack(std::uint64_t data) {
+	TableValue v;
+	std::uint32_t score = (std::uint32_t) data;
+	std::memcpy(&v.score, &score, sizeof(score));
+	v.depth = (data >> 32) & 0xFF;
+	v.bound = (data >> 40) & 0x3;
+	return v;
+}
+
+TranspositionTable::TranspositionTable() : generation(0) {
+	this->map = nullptr;
+	this->length = 0;
+	this->entries = nullptr;
+	this->buckets = 0;
+}
+
+TranspositionTable::~TranspositionTable() {
+	Close();
+}
+
+bool TranspositionTable::Create(std::size_t megabytes) {
+	Close();
+
+	std::uint64_t count = megabytes * 1024 * 1024 / (TABLE_BUCKET_ENTRIES * sizeof(TableEntry));
+	if (count == 0) return false;
+
+	std::size_t size = sizeof(TableHeader) + count * TABLE_BUCKET_ENTRIES * sizeof(TableEntry);
+	void* m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (m == MAP_FAILED) return false;
+
+	this->map = m;
+	this->length = size;
+	this->entries = (TableEntry*) ((char*) m + sizeof(TableHeader));
+	this->buckets = count;
+	return true;
+}
+
+bool TranspositionTable::Open(std::string filename, std::size_t megabytes) {
+	Close();
+
+	int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) return false;
+
+	// Processes that open the file at the same time wait until the first one has set it up.
+	flock(fd, LOCK_EX);
+
+	TableHeader header = { };
+	struct stat st;
+	bool valid = fstat(fd, &st) == 0 and (std::size_t) st.st_size >= sizeof(TableHeader);
+	valid = valid and pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header);
+	valid = valid and std::memcmp(header.magic, "SUTTT", 6) == 0 and header.version == TABLE_VERSION and header.buckets > 0;
+	valid = valid and sizeof(TableHeader) + header.buckets * TABLE_BUCKET_ENTRIES * sizeof(TableEntry) == (std::size_t) st.st_size;
+
+	if (!valid) {
+		header = { };
+		std::memcpy(header.magic, "SUTTT", 6);
+		header.version = TABLE_VERSION;
+		header.buckets = megabytes * 1024 * 1024 / (TABLE_BUCKET_ENTRIES * sizeof(TableEntry));
+
+		// Truncating first leaves every entry zeroed, which is empty.
+		bool ok = header.buckets > 0 and ftruncate(fd, 0) == 0;
+		ok = ok and ftruncate(fd, sizeof(TableHeader) + header.buckets * TABLE_BUCKET_ENTRIES * sizeof(TableEntry)) == 0;
+		ok = ok and pwrite(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header);
+
+		if (!ok) {
+			printf("Failed to set up a transposition table in %s.\n", filename.c_str());
+			flock(fd, LOCK_UN);
+			close(fd);
+			return false;
+		}
+	}
+
+	std::size_t size = sizeof(TableHeader) + header.buckets * TABLE_BUCKET_ENTRIES * sizeof(TableEntry);
+	void* m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	flock(fd, LOCK_UN);
+	close(fd);
+
+	if (m == MAP_FAILED) return false;
+
+	this->map = m;
+	this->length = size;
+	this->entries = (TableEntry*) ((char*) m + sizeof(TableHeader));
+	this->buckets = header.buckets;
+	return true;
+}
+
+void TranspositionTable::Close() {
+	if (map != nullptr) munmap(map, length);
+
+	this->map = nullptr;
+	this->length = 0;
+	this->entries = nullptr;
+	this->buckets = 0;
+}
+
+bool TranspositionTable::Probe(std::uint64_t key, TableValue& value) const {
+	if (buckets == 0) return false;
+
+	const TableEntry* b = bucket(key);
+	for (int i = 0; i < TABLE_BUCKET_ENTRIES; i++) {
+		std::uint64_t data = b[i].data.load(std::memory_order_relaxed);
+		std::uint64_t check = b[i].check.load(std::memory_order_relaxed);
+
+		if ((data & ENTRY_USED) and (check ^ data) == key) {
+			value = Unpack(data);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TranspositionTable::Store(std::uint64_t key, const TableValue& value) {
+	if (buckets == 0) return;
+
+	const std::uint8_t now = generation.load(std::memory_order_relaxed);
+	TableEntry* b = bucket(key);
+	TableEntry* victim = nullptr;
+	int worst = 1 << 30;
+
+	for (int i = 0; i < TABLE_BUCKET_ENTRIES; i++) {
+		std::uint64_t data = b[i].data.load(std::memory_order_relaxed);
+		std::uint64_t check = b[i].check.load(std::memory_order_relaxed);
+
+		if (!(data & ENTRY_USED) or (check ^ data) == key) {
+			victim = &b[i];
+			break;
+		}
+
+		int age = (std::uint8_t) (now - (std::uint8_t) (data >> 48));
+		int worth = (int) ((data >> 32) & 0xFF) - 8 * age;
+		if (worth < worst) {
+			worst = worth;
+			victim = &b[i];
+		}
+	}
+
+	std::uint64_t data = Pack(value, now);
+	victim->data.store(data, std::memory_order_relaxed);
+	victim->check.store(key ^ data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::NewSearch() {
+	generation.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,82 @@
+#ifndef TRANSPOSITION_HPP
+#define TRANSPOSITION_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define BOUND_EXACT 0
+#define BOUND_LOWER 1 // the score is at least this (the search failed high)
+#define BOUND_UPPER 2 // the score is at most this (the search failed low)
+
+struct TableValue {
+		float score; // from white's point of view
+		int depth; // 0 to 255
+		int bound;
+};
+
+// On-disk layout: a TableHeader followed by `buckets` buckets of TABLE_BUCKET_ENTRIES entries.
+struct TableHeader {
+		char magic[8]; // "SUTTT"
+		std::uint32_t version;
+		std::uint32_t reserved;
+		std::uint64_t buckets;
+		std::uint8_t padding[40]; // buckets start on a cache line
+};
+
+// An entry keeps the value and the key xor the value, written separately without locks. A reader
+// that sees the halves of different writes gets a key that does not match, so it misses.
+struct TableEntry {
+		std::atomic<std::uint64_t> check;
+		std::atomic<std::uint64_t> data;
+};
+
+const std::uint32_t TABLE_VERSION = 1;
+const int TABLE_BUCKET_ENTRIES = 4; // one cache line
+
+static_assert(sizeof(TableHeader) == 64, "the header should take one cache line");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "entries are shared between processes");
+
+// A transposition table of searched positions that is kept from search to search and shared by all
+// engines that hold it. Created on its own it lives in this process. Opened on a file, it is mapped
+// with MAP_SHARED, so every process that opens the same file shares its entries while they run, and
+// what they found is still there after a restart.
+class TranspositionTable {
+	public:
+		TranspositionTable();
+		~TranspositionTable();
+
+		bool Create(std::size_t megabytes);
+
+		// Uses the file as it is if it already holds a table, whatever its size, or sets it up with
+		// `megabytes` of empty entries.
+		bool Open(std::string filename, std::size_t megabytes);
+		void Close();
+
+		bool Probe(std::uint64_t key, TableValue& value) const;
+
+		// Replaces the entry of the same key, or in a full bucket the shallowest entry, counting entries
+		// from earlier searches as shallower than they are.
+		void Store(std::uint64_t key, const TableValue& value);
+
+		// Ages the entries stored so far, so they are replaced first.
+		void NewSearch();
+
+		inline std::size_t size() const {
+			return buckets * TABLE_BUCKET_ENTRIES;
+		}
+
+	protected:
+		void* map;
+		std::size_t length;
+		TableEntry* entries;
+		std::uint64_t buckets;
+		std::atomic<std::uint8_t> generation;
+
+		inline TableEntry* bucket(std::uint64_t key) const {
+			return entries + TABLE_BUCKET_ENTRIES * (std::uint64_t) (((unsigned __int128) key * buckets) >> 64);
+		}
+};
+
+#endif // TRANSPOSITION_HPP
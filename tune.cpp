@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include <SDL2/SDL.h>
+
+#include "board.hpp"
+#include "engine.hpp"
+#include "rules.hpp"
+#include "tune.hpp"
+
+// The evaluation is linear in these values, so a position is fitted through its value per unit of
+// each of them.
+static double EvalParams::* const TUNED[] = {
+	&EvalParams::pawn,
+	&EvalParams::knight,
+	&EvalParams::pawn_reserve,
+	&EvalParams::knight_reserve,
+	&EvalParams::pawn_capture,
+	&EvalParams::knight_capture,
+	&EvalParams::center,
+	&EvalParams::move
+};
+
+const int TUNED_COUNT = sizeof(TUNED) / sizeof(TUNED[0]);
+
+static bool SelfPlayWorker(std::string filename, std::atomic<int>& next, int games, int depth, unsigned seed, std::atomic<unsigned long>& written) {
+	std::FILE* pFile = std::fopen(filename.c_str(), "wb");
+	if (pFile == nullptr) {
+		printf("Failed to open %s for writing.\n", filename.c_str());
+		return false;
+	}
+
+	SampleHeader header = { };
+	std::strncpy(header.magic, "SUTSMPL", sizeof(header.magic));
+	header.version = SAMPLE_VERSION;
+	bool ok = std::fwrite(&header, sizeof(header), 1, pFile) == 1;
+
+	Engine engine;
+	engine.useBook = false;
+	std::mt19937 rng(seed);
+	std::vector<Sample> samples;
+
+	int game;
+	while (ok and (game = next++) < games) {
+		Board board(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+		board.NewGame(DEFAULT_PAWNS, DEFAULT_KNIGHTS, DEFAULT_FLANKING);
+
+		for (int i = 0; i < TUNE_OPENING_PLIES and board.WinState() == WINSTATE_NONE; i++) {
+			std::vector<Turn> turns = board.possibleTurns();
+			if (turns.empty()) break;
+			board.PlayTurn(turns[rng() % turns.size()]);
+		}
+
+		samples.clear();
+		int result = WINSTATE_DRAW;
+
+		for (int ply = 0; ply < TUNE_MAX_PLIES; ply++) {
+			int state = board.WinState();
+			if (state != WINSTATE_NONE) {
+				result = state;
+				break;
+			}
+
+			SearchResult r = engine.Search(&board, depth);
+			if (!r.found) {
+				result = (board.getTurn() ? WINSTATE_BLACK : WINSTATE_WHITE);
+				break;
+			}
+
+			Sample s = { };
+			s.position = board.getPosition();
+			s.score = (float) r.score;
+			s.depth = r.depth;
+			samples.push_back(s);
+
+			board.PlayTurn(r.turn);
+		}
+
+		for (Sample& s : samples) {
+			s.result = (result == WINSTATE_WHITE ? +1 : (result == WINSTATE_BLACK ? -1 : 0));
+		}
+
+		ok = std::fwrite(samples.data(), sizeof(Sample), samples.size(), pFile) == samples.size();
+		header.count += samples.size();
+		written += samples.size();
+
+		printf("Game %d: %s after %lu plies, %lu positions so far.\n", game + 1, (result == WINSTATE_WHITE ? "white wins" : (result == WINSTATE_BLACK ? "black wins" : "draw")), samples.size(), (unsigned long) written);
+	}
+
+	// The header goes in last, once the number of samples is known.
+	ok = ok and std::fseek(pFile, 0, SEEK_SET) == 0 and std::fwrite(&header, sizeof(header), 1, pFile) == 1;
+	return std::fclose(pFile) == 0 and ok;
+}
+
+bool GenerateSamples(std::string prefix, int games, int depth, int threads) {
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::atomic<int> next(0);
+	std::atomic<unsigned long> written(0);
+	std::vector<char> ok(threads, true);
+	std::random_device rd;
+	unsigned start = SDL_GetTicks();
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++) {
+		std::string filename = prefix + "-" + std::to_string(i) + ".bin";
+		workers.push_back(std::thread([&, filename, i](unsigned seed) {
+			ok[i] = SelfPlayWorker(filename, next, games, depth, seed, written);
+		}, rd()));
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	printf("Wrote %lu positions to %d shards in %.0f s.\n", (unsigned long) written, threads, 0.001 * (SDL_GetTicks() - start));
+	return std::all_of(ok.begin(), ok.end(), [](char c) { return c != 0; });
+}
+
+// A sample as the tuner sees it: the evaluation per unit of each value, and the target score.
+struct TuneEntry {
+		double features[TUNED_COUNT];
+		double target; // 0 (black wins) to 1 (white wins)
+		double score; // search score
+		double result; // 0, 0.5 or 1
+};
+
+static bool LoadShard(std::string filename, std::vector<TuneEntry>& entries) {
+	std::FILE* pFile = std::fopen(filename.c_str(), "rb");
+	if (pFile == nullptr) {
+		printf("Failed to open %s.\n", filename.c_str());
+		return false;
+	}
+
+	SampleHeader header;
+	if (std::fread(&header, sizeof(header), 1, pFile) != 1 or std::memcmp(header.magic, "SUTSMPL", 8) != 0 or header.version != SAMPLE_VERSION) {
+		printf("%s is not a sample shard.\n", filename.c_str());
+		std::fclose(pFile);
+		return false;
+	}
+
+	EvalParams unit[TUNED_COUNT];
+	for (int i = 0; i < TUNED_COUNT; i++) {
+		for (int j = 0; j < TUNED_COUNT; j++) {
+			unit[i].*TUNED[j] = (i == j ? 1.0 : 0.0);
+		}
+	}
+
+	Sample s;
+	std::uint64_t read = 0;
+	while (read < header.count and std::fread(&s, sizeof(s), 1, pFile) == 1) {
+		read++;
+		if (std::fabs(s.score) >= TUNE_SCORE_LIMIT) continue;
+
+		const Rules* rules = RulesFor(s.position.width, s.position.height);
+		if (rules == nullptr) continue;
+
+		TuneEntry e;
+		for (int i = 0; i < TUNED_COUNT; i++) {
+			e.features[i] = rules->Evaluate(s.position, unit[i]);
+		}
+
+		e.score = s.score;
+		e.result = 0.5 * (s.result + 1);
+		entries.push_back(e);
+	}
+
+	std::fclose(pFile);
+	if (read < header.count) printf("%s: only %lu of %lu samples could be read.\n", filename.c_str(), (unsigned long) read, (unsigned long) header.count);
+	return true;
+}
+
+static inline double Sigmoid(double x) {
+	return 1.0 / (1.0 + std::exp(-x));
+}
+
+static inline double Predict(const TuneEntry& e, const double* values) {
+	double eval = 0.0;
+	for (int i = 0; i < TUNED_COUNT; i++) {
+		eval += values[i] * e.features[i];
+	}
+	return eval;
+}
+
+// Mean squared error of the predictions, and its gradient if one is given, over all threads.
+static double Error(const std::vector<TuneEntry>& entries, const double* values, double k, double* gradient, int threads) {
+	std::vector<double> errors(threads, 0.0);
+	std::vector<double> gradients(threads * TUNED_COUNT, 0.0);
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.push_back(std::thread([&, t]() {
+			double* g = gradients.data() + t * TUNED_COUNT;
+			for (std::size_t n = t; n < entries.size(); n += threads) {
+				const TuneEntry& e = entries[n];
+				double p = Sigmoid(k * Predict(e, values));
+				double d = p - e.target;
+				errors[t] += d * d;
+
+				if (gradient == nullptr) continue;
+
+				double slope = 2.0 * d * p * (1.0 - p) * k;
+				for (int i = 0; i < TUNED_COUNT; i++) {
+					g[i] += slope * e.features[i];
+				}
+			}
+		}));
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	double error = 0.0;
+	for (int t = 0; t < threads; t++) {
+		error += errors[t];
+	}
+
+	if (gradient != nullptr) {
+		for (int i = 0; i < TUNED_COUNT; i++) {
+			gradient[i] = 0.0;
+			for (int t = 0; t < threads; t++) {
+				gradient[i] += gradients[t * TUNED_COUNT + i];
+			}
+			gradient[i] /= entries.size();
+		}
+	}
+
+	return error / entries.size();
+}
+
+bool TuneEvalParams(std::string output, const std::vector<std::string>& shards, int iterations) {
+	std::vector<TuneEntry> entries;
+	for (const std::string& s : shards) {
+		if (!LoadShard(s, entries)) return false;
+	}
+
+	if (entries.empty()) {
+		printf("No samples to tune on.\n");
+		return false;
+	}
+
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	EvalParams params;
+	double values[TUNED_COUNT];
+	for (int i = 0; i < TUNED_COUNT; i++) {
+		values[i] = params.*TUNED[i];
+	}
+
+	// First the scale of the logistic curve that fits the game results best, by golden section.
+	for (TuneEntry& e : entries) {
+		e.target = e.result;
+	}
+
+	double lo = 0.01, hi = 10.0;
+	const double phi = (std::sqrt(5.0) - 1.0) / 2.0;
+	for (int i = 0; i < 40; i++) {
+		double a = hi - phi * (hi - lo), b = lo + phi * (hi - lo);
+		if (Error(entries, values, a, nullptr, threads) < Error(entries, values, b, nullptr, threads)) hi = b;
+		else lo = a;
+	}
+
+	const double k = 0.5 * (lo + hi);
+	for (TuneEntry& e : entries) {
+		e.target = TUNE_RESULT_WEIGHT * e.result + (1.0 - TUNE_RESULT_WEIGHT) * Sigmoid(k * e.score);
+	}
+
+	printf("Tuning on %lu positions, scale %.3f, error %.6f.\n", entries.size(), k, Error(entries, values, k, nullptr, threads));
+
+	// Then the values, with Adam.
+	double gradient[TUNED_COUNT], m[TUNED_COUNT] = { }, v[TUNED_COUNT] = { };
+	const double beta1 = 0.9, beta2 = 0.999;
+
+	for (int it = 1; it <= iterations; it++) {
+		double error = Error(entries, values, k, gradient, threads);
+
+		for (int i = 0; i < TUNED_COUNT; i++) {
+			m[i] = beta1 * m[i] + (1.0 - beta1) * gradient[i];
+			v[i] = beta2 * v[i] + (1.0 - beta2) * gradient[i] * gradient[i];
+			double mh = m[i] / (1.0 - std::pow(beta1, it)), vh = v[i] / (1.0 - std::pow(beta2, it));
+			values[i] -= TUNE_LEARNING_RATE * mh / (std::sqrt(vh) + 1e-12);
+		}
+
+		if (it % 100 == 0 or it == iterations) printf("Iteration %d: error %.6f\n", it, error);
+	}
+
+	for (int i = 0; i < TUNED_COUNT; i++) {
+		params.*TUNED[i] = values[i];
+	}
+
+	if (!SaveEvalParams(output, params)) {
+		printf("Failed to write %s.\n", output.c_str());
+		return false;
+	}
+
+	printf("Wrote the tuned values to %s.\n", output.c_str());
+	return true;
+}
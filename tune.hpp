@@ -0,0 +1,38 @@
+#ifndef TUNE_HPP
+#define TUNE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "position.hpp"
+
+// On-disk layout of a shard: a SampleHeader followed by `count` Sample records.
+struct SampleHeader {
+		char magic[8]; // "SUTSMPL"
+		std::uint32_t version;
+		std::uint32_t reserved;
+		std::uint64_t count;
+};
+
+struct Sample {
+		WidePosition position;
+		float score; // search score, from white's point of view
+		std::int8_t result; // of the game: +1 if white won, -1 if black won, 0 for a draw
+		std::uint8_t depth;
+		std::uint16_t reserved;
+};
+
+const std::uint32_t SAMPLE_VERSION = 1;
+
+// Plays `games` games of the engine against itself to the given depth on `threads` threads (all
+// cores if 0), each from TUNE_OPENING_PLIES random plies, and writes every position after the
+// opening with its search score and the result of the game to <prefix>-<thread>.bin.
+bool GenerateSamples(std::string prefix, int games, int depth, int threads);
+
+// Fits the evaluation values (except EVAL_DISPERSION) to the samples in the shards, Texel style:
+// the evaluation through a logistic curve should predict a mix of the game result and the search
+// score. Writes the values to output in the format of LoadEvalParams.
+bool TuneEvalParams(std::string output, const std::vector<std::string>& shards, int iterations);
+
+#endif // TUNE_HPP
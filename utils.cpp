@@ -4,6 +4,7 @@
 #include <SDL2/SDL_image.h>
 
 #include "defines.hpp"
+#include "utils.hpp"
 
 SDL_Texture* tex_pieces = nullptr;
 SDL_Texture* tex_selections = nullptr;
@@ -38,12 +39,57 @@ bool LoadTextures(SDL_Renderer* context) {
 	return true;
 }
 
-void RenderArrow(SDL_Renderer* context, int x1, int y1, int x2, int y2) {
+SpriteBatch::SpriteBatch(SDL_Texture* texture) {
+	this->texture = texture;
+}
+
+void SpriteBatch::Add(const SDL_Rect& src, const SDL_Rect& dst, SDL_Color color, double angle, SDL_Point center) {
+	const int corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+	double c = std::cos(angle * PI / 180.0), s = std::sin(angle * PI / 180.0);
+	int first = vertices.size();
+
+	for (int i = 0; i < 4; i++) {
+		double x = corners[i][0] * dst.w - center.x, y = corners[i][1] * dst.h - center.y;
+
+		SDL_Vertex v;
+		v.position.x = (float) (dst.x + center.x + x * c - y * s);
+		v.position.y = (float) (dst.y + center.y + x * s + y * c);
+		v.color = color;
+		// Texture coordinates stay in pixels until Flush knows the size of the texture.
+		v.tex_coord.x = (float) (src.x + corners[i][0] * src.w);
+		v.tex_coord.y = (float) (src.y + corners[i][1] * src.h);
+		vertices.push_back(v);
+	}
+
+	const int order[6] = { 0, 1, 2, 0, 2, 3 };
+	for (int i : order) {
+		indices.push_back(first + i);
+	}
+}
+
+void SpriteBatch::Flush(SDL_Renderer* context) {
+	if (vertices.empty()) return;
+
+	int w = 1, h = 1;
+	if (texture != nullptr) SDL_QueryTexture(texture, nullptr, nullptr, &w, &h);
+
+	for (SDL_Vertex& v : vertices) {
+		v.tex_coord.x /= w;
+		v.tex_coord.y /= h;
+	}
+
+	SDL_RenderGeometry(context, texture, vertices.data(), vertices.size(), indices.data(), indices.size());
+
+	vertices.clear();
+	indices.clear();
+}
+
+void AddArrow(SpriteBatch& batch, int x1, int y1, int x2, int y2, SDL_Color color) {
 	int len = (int) std::sqrt(std::pow(std::abs(x2 - x1) + TEX_WIDTH, 2.0) + std::pow(y2 - y1, 2.0));
 	double ang = std::atan2(y2 - y1, x2 - x1) * 180.0 / PI;
 
 	SDL_Rect src = { 0, TEX_HEIGHT, 2 * TEX_WIDTH, TEX_HEIGHT }, dst = { x1, y1, len, TEX_HEIGHT };
 	SDL_Point pt = { TEX_WIDTH / 2, TEX_HEIGHT / 2 };
 
-	SDL_RenderCopyEx(context, tex_selections, &src, &dst, ang, &pt, SDL_FLIP_NONE);
+	batch.Add(src, dst, color, ang, pt);
 }
@@ -1,10 +1,29 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
-struct SDL_Renderer;
+#include <vector>
+
+#include <SDL2/SDL.h>
 
 bool LoadTextures(SDL_Renderer* context);
 
-void RenderArrow(SDL_Renderer* context, int x1, int y1, int x2, int y2);
+// Textured quads drawn with a single SDL_RenderGeometry call, in the order they were added. The
+// colour of each quad works like SDL_SetTextureColorMod and SDL_SetTextureAlphaMod; without a
+// texture the quads are filled with it.
+class SpriteBatch {
+	public:
+		SpriteBatch(SDL_Texture* texture);
+
+		// Rotates dst by angle degrees (clockwise) around center, relative to the top left of dst.
+		void Add(const SDL_Rect& src, const SDL_Rect& dst, SDL_Color color, double angle = 0.0, SDL_Point center = { 0, 0 });
+		void Flush(SDL_Renderer* context);
+
+	protected:
+		SDL_Texture* texture;
+		std::vector<SDL_Vertex> vertices;
+		std::vector<int> indices;
+};
+
+void AddArrow(SpriteBatch& batch, int x1, int y1, int x2, int y2, SDL_Color color);
 
 #endif // UTILS_HPP